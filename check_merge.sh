@@ -0,0 +1,39 @@
+#!/bin/sh
+# Checks that merging train-partial shards gives the same model as training
+# on the whole file.
+#   ./check_merge.sh [sentiment binary] [shards] [training csv]
+set -e
+
+SENTIMENT=${1:-./sentiment}
+SHARDS=${2:-4}
+TRAINING=${3:-data/train_dataset_20k.csv}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# Contiguous shards, each with the CSV header
+awk -v shards="$SHARDS" -v work="$WORK" '
+    NR == 1 { header = $0; next }
+    { rows[NR - 1] = $0 }
+    END {
+        total = NR - 1
+        for (s = 0; s < shards; ++s) {
+            file = sprintf("%s/shard%02d.csv", work, s)
+            print header > file
+            for (r = int(total * s / shards) + 1; r <= int(total * (s + 1) / shards); ++r)
+                print rows[r] > file
+            close(file)
+        }
+    }' "$TRAINING"
+
+for shard in "$WORK"/shard*.csv; do
+    "$SENTIMENT" train-partial "$shard" -o "${shard%.csv}.model" > /dev/null
+done
+"$SENTIMENT" merge "$WORK"/shard*.model -o "$WORK/merged.model" > /dev/null
+"$SENTIMENT" train-partial "$TRAINING" -o "$WORK/whole.model" > /dev/null
+
+if cmp "$WORK/merged.model" "$WORK/whole.model"; then
+    echo "Merged model of $SHARDS shards matches whole-file training"
+else
+    echo "Merged model of $SHARDS shards differs from whole-file training"
+    exit 1
+fi
@@ -1,14 +1,52 @@
+#include "sentiment.h"
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <map>
-#include <unordered_map>
-#include <unordered_set>
+#include <queue>
+#include <type_traits>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
 #include <iomanip>
+#include <chrono>
 #include <algorithm>
 #include <stdexcept>
 #include <tuple>
+#include <cctype>
+#include <limits>
+#include <memory>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define SENTIMENT_HAVE_IO_URING 1
+#endif
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Everything up to the Library API has internal linkage, so an application
+// linking the library build sees only the sentiment:: API symbols. Code
+// only the command line uses is left out of the library build.
+namespace {
 
 // ----------------------- DSString Class -----------------------
 class DSString {
@@ -45,6 +83,20 @@ public:
         copyData(other.data);
     }
 
+    DSString(DSString&& other) noexcept : data(other.data), len(other.len) {
+        other.data = nullptr;
+        other.len = 0;
+    }
+
+    // Construct from a buffer that is not null-terminated
+    DSString(const char* str, size_t length) : len(length) {
+        data = new char[len + 1];
+        for (size_t i = 0; i < len; ++i) {
+            data[i] = str[i];
+        }
+        data[len] = '\0';
+    }
+
     // Destructor
     ~DSString() {
         delete[] data;
@@ -59,6 +111,17 @@ public:
         return *this;
     }
 
+    DSString& operator=(DSString&& other) noexcept {
+        if (this != &other) {
+            delete[] data;
+            data = other.data;
+            len = other.len;
+            other.data = nullptr;
+            other.len = 0;
+        }
+        return *this;
+    }
+
     // Equality operator
     bool operator==(const DSString& other) const {
         if (len != other.len)
@@ -167,324 +230,4359 @@ public:
     }
 };
 
-// Hash specialization for DSString
-namespace std {
-    template <>
-    struct hash<DSString> {
-        size_t operator()(const DSString& s) const {
-            size_t hashVal = 0;
-            for (size_t i = 0; i < s.length(); ++i) {
-                hashVal = hashVal * 31 + static_cast<size_t>(s.c_str()[i]);
-            }
-            return hashVal;
-        }
-    };
+// Hash and equality for DSString keys that also accept std::string_view, so
+// lookups can probe with borrowed text without building a DSString
+inline size_t hashChars(const char* str, size_t length) {
+    size_t hashVal = 0;
+    for (size_t i = 0; i < length; ++i) {
+        hashVal = hashVal * 31 + static_cast<size_t>(str[i]);
+    }
+    return hashVal;
 }
 
-// ------------------- SentimentClassifier Class -------------------
-class SentimentClassifier {
+struct DSStringHash {
+    size_t operator()(const DSString& s) const { return hashChars(s.c_str(), s.length()); }
+    size_t operator()(std::string_view s) const { return hashChars(s.data(), s.size()); }
+};
+
+struct DSStringEqual {
+    bool operator()(const DSString& a, const DSString& b) const { return a == b; }
+    bool operator()(const DSString& a, std::string_view b) const {
+        return a.length() == b.size() && std::memcmp(a.c_str(), b.data(), b.size()) == 0;
+    }
+};
+
+// ----------------------- DSHashMap Class -----------------------
+// Open-addressing hash map laid out like a Swiss table. Each slot has one
+// control byte holding either EMPTY or the low 7 bits of the key's hash;
+// lookups compare a whole 16-byte group of control bytes at once (SSE2 when
+// available) and only touch the slots whose byte matches. Keys and values
+// are stored inline in one flat array, so a rehash moves them rather than
+// reallocating nodes. Erase leaves a DELETED tombstone so probe sequences
+// stay intact; tombstones are dropped by the next rehash, which keeps the
+// capacity when most of the load is tombstones.
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class DSHashMap {
 public:
-    // Training, Prediction, and Evaluation functions
-    void train(const std::string& trainingFile);
-    void predict(const std::string& testingFile, const std::string& resultsFile);
-    void evaluatePredictions(const std::string& groundTruthFile, const std::string& resultsFile, const std::string& accuracyFile);
+    using value_type = std::pair<K, V>;
 
-private:
-    std::unordered_map<DSString, int> wordSentiment; // Positive count if value > 0, negative if < 0
-    std::unordered_set<DSString> stopWords; // Set of stop words to ignore during tokenization
+    template <bool Const>
+    class Iterator {
+    public:
+        using Map = typename std::conditional<Const, const DSHashMap, DSHashMap>::type;
+        using Ref = typename std::conditional<Const, const value_type&, value_type&>::type;
+        using Ptr = typename std::conditional<Const, const value_type*, value_type*>::type;
 
-    // Helper functions
-    void loadStopWords(); // Load a predefined set of stop words
-    DSString stem(const DSString& word); // Simple stemmer
-    void tokenize(const DSString& tweet, std::vector<DSString>& words);
-    DSString toLower(const DSString& word);
-};
+        Iterator(Map* map, size_t index) : map(map), index(index) { skipEmpty(); }
+        Ref operator*() const { return map->slots[index]; }
+        Ptr operator->() const { return &map->slots[index]; }
+        Iterator& operator++() {
+            ++index;
+            skipEmpty();
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return index == other.index; }
+        bool operator!=(const Iterator& other) const { return index != other.index; }
 
-// Load a predefined set of stop words
-void SentimentClassifier::loadStopWords() {
-    // A minimal set of English stop words. For a comprehensive list, consider expanding this.
-    std::vector<std::string> stopWordsList = {
-        "a", "an", "and", "are", "as", "at", "be", "but", "by",
-        "for", "if", "in", "into", "is", "it",
-        "no", "not", "of", "on", "or", "such",
-        "that", "the", "their", "then", "there", "these",
-        "they", "this", "to", "was", "will", "with",
-        "have", "has", "had", "do", "does", "did",
-        "from", "up", "down", "out", "about", "above", "below",
-        "under", "again", "further", "once", "here",
-        "there", "when", "where", "why", "how", "all", "any",
-        "both", "each", "few", "more", "most", "other", "some",
-        "only", "own", "same", "so", "than", "too",
-        "very", "can", "will", "just", "don't", "should", "now"
+    private:
+        friend class DSHashMap;
+        Map* map;
+        size_t index;
+
+        void skipEmpty() {
+            while (index < map->capacity && !isFull(map->ctrl[index]))
+                ++index;
+        }
     };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
 
-    for (const auto& word : stopWordsList) {
-        DSString dsWord(word.c_str());
-        stopWords.insert(dsWord);
+    DSHashMap() {}
+    // For Hash and KeyEqual with state, such as a pointer to pooled key bytes
+    DSHashMap(const Hash& hash, const KeyEqual& keyEqual) : hasher(hash), equal(keyEqual) {}
+    ~DSHashMap() { release(); }
+
+    DSHashMap(const DSHashMap&) = delete;
+    DSHashMap& operator=(const DSHashMap&) = delete;
+
+    DSHashMap(DSHashMap&& other) noexcept { swap(other); }
+    DSHashMap& operator=(DSHashMap&& other) noexcept {
+        if (this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
     }
-}
 
-// Simple stemmer: removes common suffixes
-DSString SentimentClassifier::stem(const DSString& word) {
-    std::string w = word.c_str();
-    // Simple suffix stripping
-    if (w.length() > 4 && w.substr(w.length() - 3) == "ing") {
-        w = w.substr(0, w.length() - 3);
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, capacity); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, capacity); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t bucket_count() const { return capacity; }
+
+    // Bytes held by the control and slot arrays (not counting key payloads)
+    size_t memoryBytes() const { return capacity * (1 + sizeof(value_type)); }
+
+    // New keys that fit before the next insert doubles the arrays
+    size_t insertsBeforeGrowth() const { return growthLeft; }
+
+    // Size the table so that expected entries fit without rehashing
+    void reserve(size_t expected) {
+        size_t needed = GROUP;
+        while (needed - needed / 8 < expected)
+            needed *= 2;
+        if (needed > capacity)
+            rehash(needed);
     }
-    else if (w.length() > 3 && w.substr(w.length() - 2) == "ed") {
-        w = w.substr(0, w.length() - 2);
+
+    void clear() {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (isFull(ctrl[i]))
+                slots[i].~value_type();
+            ctrl[i] = EMPTY;
+        }
+        count = 0;
+        growthLeft = capacity - capacity / 8;
     }
-    else if (w.length() > 1 && w.back() == 's') {
-        w.pop_back();
+
+    // Lookup by K or by any type Hash and KeyEqual accept (e.g. string_view)
+    template <typename Q>
+    iterator find(const Q& key) { return iterator(this, findIndex(key)); }
+    template <typename Q>
+    const_iterator find(const Q& key) const { return const_iterator(this, findIndex(key)); }
+    template <typename Q>
+    bool contains(const Q& key) const { return findIndex(key) != capacity; }
+
+    // Split lookups: hash keys up front, prefetch their first probe group,
+    // then find with the saved hash
+    template <typename Q>
+    size_t hashKey(const Q& key) const { return mix(hasher(key)); }
+    void prefetch(size_t hash) const {
+        if (capacity == 0)
+            return;
+        size_t index = firstGroup(hash) * GROUP;
+        __builtin_prefetch(ctrl + index);
+        __builtin_prefetch(slots + index);
     }
-    return DSString(w.c_str());
-}
+    template <typename Q>
+    const_iterator find(const Q& key, size_t hash) const { return const_iterator(this, findIndex(key, hash)); }
 
-// Convert DSString to lowercase
-DSString SentimentClassifier::toLower(const DSString& word) {
-    std::string temp = word.c_str();
-    std::transform(temp.begin(), temp.end(), temp.begin(), ::tolower);
-    return DSString(temp.c_str());
-}
+    // Insert (key, value) unless key is present; returns the entry and whether it was inserted.
+    // An rvalue key is moved into the slot, and only when it is inserted.
+    std::pair<iterator, bool> try_emplace(const K& key, const V& value = V()) { return emplaceKey(key, value); }
+    std::pair<iterator, bool> try_emplace(K&& key, const V& value = V()) { return emplaceKey(std::move(key), value); }
 
-// Tokenize a tweet into words, removing stop words and punctuation
-void SentimentClassifier::tokenize(const DSString& tweet, std::vector<DSString>& words) {
-    std::string tweetStr = tweet.c_str();
-    std::transform(tweetStr.begin(), tweetStr.end(), tweetStr.begin(), ::tolower);
+    V& operator[](const K& key) { return try_emplace(key).first->second; }
+    V& operator[](K&& key) { return try_emplace(std::move(key)).first->second; }
 
-    std::stringstream ss(tweetStr);
-    std::string word;
-    while (ss >> word) {
-        // Remove punctuation from the word
-        word.erase(std::remove_if(word.begin(), word.end(), ::ispunct), word.end());
-        if (word.empty())
-            continue;
+    void erase(iterator it) {
+        ctrl[it.index] = DELETED; // Still counted against growthLeft until a rehash
+        slots[it.index].~value_type();
+        count--;
+    }
+    template <typename Q>
+    bool erase(const Q& key) {
+        size_t index = findIndex(key);
+        if (index == capacity)
+            return false;
+        erase(iterator(this, index));
+        return true;
+    }
 
-        // Apply stemming
-        DSString dsWord = stem(DSString(word.c_str()));
-        
-        if (stopWords.find(dsWord) == stopWords.end()) { // If not a stop word
-            words.emplace_back(dsWord);
-        }
+private:
+    static const int8_t EMPTY = -128;
+    static const int8_t DELETED = -2;
+    static const size_t GROUP = 16;
+
+    int8_t* ctrl = nullptr;
+    value_type* slots = nullptr;
+    size_t capacity = 0; // Zero or a power of two no smaller than GROUP
+    size_t count = 0;
+    size_t growthLeft = 0; // Inserts left before the 7/8 load factor is reached
+    Hash hasher;
+    KeyEqual equal;
+
+    // Spread weak hashes (such as the identity hash of integers) over all bits
+    static size_t mix(size_t hash) {
+        uint64_t h = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 32));
     }
-}
+    static int8_t h2(size_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+    static bool isFull(int8_t control) { return control >= 0; } // Neither EMPTY nor DELETED
+    size_t firstGroup(size_t hash) const { return (hash >> 7) & (capacity / GROUP - 1); }
 
-// Training function
-void SentimentClassifier::train(const std::string& trainingFile) {
-    loadStopWords();
+    // Bit i is set when control byte i of the group equals value
+    static uint32_t matchGroup(const int8_t* group, int8_t value) {
+#if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP; ++i)
+            mask |= static_cast<uint32_t>(group[i] == value) << i;
+        return mask;
+#endif
+    }
 
-    std::ifstream file(trainingFile);
-    if (!file.is_open()) {
-        std::cerr << "Error opening training file: " << trainingFile << std::endl;
-        exit(1);
+    template <typename Key>
+    std::pair<iterator, bool> emplaceKey(Key&& key, const V& value) {
+        size_t hash = mix(hasher(key));
+        size_t index = findIndex(key, hash);
+        if (index != capacity)
+            return { iterator(this, index), false };
+        if (growthLeft == 0) {
+            // Mostly tombstones: rebuild at the same size instead of doubling
+            bool crowded = count * 16 >= (capacity - capacity / 8) * 7;
+            rehash((capacity == 0) ? GROUP : crowded ? capacity * 2 : capacity);
+        }
+        index = insertIndex(hash);
+        new (&slots[index]) value_type(std::forward<Key>(key), value);
+        count++;
+        growthLeft--;
+        return { iterator(this, index), true };
     }
 
-    std::string line;
-    // No header line based on assignment examples
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string sentimentStr, id, date, query, user, tweet;
-
-        // Parse CSV line
-        if (!std::getline(ss, sentimentStr, ',')) continue;
-        if (!std::getline(ss, id, ',')) continue;
-        if (!std::getline(ss, date, ',')) continue;
-        if (!std::getline(ss, query, ',')) continue;
-        if (!std::getline(ss, user, ',')) continue;
-        if (!std::getline(ss, tweet)) continue;
+    template <typename Q>
+    size_t findIndex(const Q& key) const { return findIndex(key, mix(hasher(key))); }
 
-        int sentiment;
-        try {
-            sentiment = std::stoi(sentimentStr);
+    template <typename Q>
+    size_t findIndex(const Q& key, size_t hash) const {
+        if (capacity == 0)
+            return capacity;
+        size_t groupMask = capacity / GROUP - 1;
+        size_t group = firstGroup(hash);
+        // Triangular probing visits every group once when the group count is a power of two
+        for (size_t step = 1; step <= groupMask + 1; ++step) {
+            const int8_t* groupCtrl = ctrl + group * GROUP;
+            for (uint32_t match = matchGroup(groupCtrl, h2(hash)); match != 0; match &= match - 1) {
+                size_t index = group * GROUP + static_cast<size_t>(__builtin_ctz(match));
+                if (equal(slots[index].first, key))
+                    return index;
+            }
+            if (matchGroup(groupCtrl, EMPTY) != 0)
+                return capacity;
+            group = (group + step) & groupMask;
         }
-        catch (...) {
-            // Invalid sentiment value
-            continue;
+        return capacity;
+    }
+
+    // First empty slot on the probe sequence of hash; the table must not be full
+    size_t insertIndex(size_t hash) {
+        size_t groupMask = capacity / GROUP - 1;
+        size_t group = firstGroup(hash);
+        for (size_t step = 1;; ++step) {
+            uint32_t empty = matchGroup(ctrl + group * GROUP, EMPTY);
+            if (empty != 0) {
+                size_t index = group * GROUP + static_cast<size_t>(__builtin_ctz(empty));
+                ctrl[index] = h2(hash);
+                return index;
+            }
+            group = (group + step) & groupMask;
         }
+    }
 
-        if (sentiment != 0 && sentiment != 4)
-            continue; // Ignore sentiments not 0 or 4
+    void rehash(size_t newCapacity) {
+        int8_t* oldCtrl = ctrl;
+        value_type* oldSlots = slots;
+        size_t oldCapacity = capacity;
 
-        DSString tweetDS(tweet.c_str());
-        std::vector<DSString> words;
-        tokenize(tweetDS, words);
+        ctrl = new int8_t[newCapacity];
+        std::memset(ctrl, EMPTY, newCapacity);
+        slots = static_cast<value_type*>(::operator new(newCapacity * sizeof(value_type)));
+        capacity = newCapacity;
+        growthLeft = capacity - capacity / 8 - count;
 
-        for (const auto& word : words) {
-            if (sentiment == 4)
-                wordSentiment[word] += 1; // Positive
-            else
-                wordSentiment[word] -= 1; // Negative
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (!isFull(oldCtrl[i]))
+                continue;
+            size_t index = insertIndex(mix(hasher(oldSlots[i].first)));
+            new (&slots[index]) value_type(std::move(oldSlots[i]));
+            oldSlots[i].~value_type();
         }
+        delete[] oldCtrl;
+        ::operator delete(oldSlots);
     }
 
-    file.close();
-    std::cout << "Training completed. Vocabulary size: " << wordSentiment.size() << std::endl;
+    void release() {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (isFull(ctrl[i]))
+                slots[i].~value_type();
+        }
+        delete[] ctrl;
+        ::operator delete(slots);
+        ctrl = nullptr;
+        slots = nullptr;
+        capacity = count = growthLeft = 0;
+    }
+
+    void swap(DSHashMap& other) {
+        std::swap(ctrl, other.ctrl);
+        std::swap(slots, other.slots);
+        std::swap(capacity, other.capacity);
+        std::swap(count, other.count);
+        std::swap(growthLeft, other.growthLeft);
+        std::swap(hasher, other.hasher);
+        std::swap(equal, other.equal);
+    }
+};
+
+
+#ifndef SENTIMENT_LIBRARY
+// ----------------------- MappedFile Class -----------------------
+// Read-only memory mapping of an entire file
+class MappedFile {
+public:
+    MappedFile() : base(nullptr), size(0) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    // Hint the kernel to read ahead the given byte range
+    void willNeed(uint64_t offset, uint64_t length) const;
+
+    const char* data() const { return base; }
+    size_t length() const { return size; }
+
+private:
+    const char* base;
+    size_t size;
+};
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (mapped == MAP_FAILED)
+        return false;
+
+    base = static_cast<const char*>(mapped);
+    size = static_cast<size_t>(st.st_size);
+    return true;
 }
 
-// Prediction function
-void SentimentClassifier::predict(const std::string& testingFile, const std::string& resultsFile) {
-    std::ifstream file(testingFile);
-    if (!file.is_open()) {
-        std::cerr << "Error opening testing file: " << testingFile << std::endl;
-        exit(1);
+void MappedFile::close() {
+    if (base)
+        munmap(const_cast<char*>(base), size);
+    base = nullptr;
+    size = 0;
+}
+
+void MappedFile::willNeed(uint64_t offset, uint64_t length) const {
+    if (!base || offset >= size)
+        return;
+    // madvise needs a page-aligned start address
+    uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t start = offset - (offset % pageSize);
+    uint64_t end = std::min<uint64_t>(offset + length, size);
+    madvise(const_cast<char*>(base) + start, end - start, MADV_WILLNEED);
+}
+
+// ----------------------- Asynchronous File I/O -----------------------
+// Line-oriented dataset reading and result writing with a choice of backend:
+//   Stream  std::ifstream / std::ofstream (the original behavior)
+//   Pread   large synchronous pread/pwrite chunks, no iostream layer
+//   Uring   Linux io_uring: several chunk reads kept in flight ahead of the
+//           parser, and full output buffers written asynchronously while
+//           the next one fills
+// Uring falls back to Pread when the kernel (or a seccomp filter) refuses
+// io_uring, and any chunk whose asynchronous request fails is redone with
+// pread/pwrite.
+enum class IoBackend { Stream, Pread, Uring };
+
+bool parseIoBackend(const std::string& name, IoBackend& backend) {
+    if (name == "stream")
+        backend = IoBackend::Stream;
+    else if (name == "pread")
+        backend = IoBackend::Pread;
+    else if (name == "uring")
+        backend = IoBackend::Uring;
+    else
+        return false;
+    return true;
+}
+
+static const size_t IO_CHUNK_BYTES = 1 << 20;
+static const unsigned IO_READ_DEPTH = 8; // Chunk reads in flight ahead of the parser
+static const unsigned IO_WRITE_DEPTH = 4; // Output buffers (one filling, the rest being written)
+
+// Read or write all of length bytes at offset, retrying short transfers
+bool preadFully(int fd, char* buffer, size_t length, uint64_t offset, size_t& done) {
+    done = 0;
+    while (done < length) {
+        ssize_t n = pread(fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        if (n == 0)
+            break; // End of file
+        done += static_cast<size_t>(n);
     }
+    return true;
+}
 
-    std::ofstream results(resultsFile);
-    if (!results.is_open()) {
-        std::cerr << "Error opening results file: " << resultsFile << std::endl;
-        exit(1);
+bool pwriteFully(int fd, const char* buffer, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pwrite(fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += static_cast<size_t>(n);
     }
+    return true;
+}
 
-    std::string line;
-    // No header line based on assignment examples
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string id, date, query, user, tweet;
-        if (!std::getline(ss, id, ',')) continue;
-        if (!std::getline(ss, date, ',')) continue;
-        if (!std::getline(ss, query, ',')) continue;
-        if (!std::getline(ss, user, ',')) continue;
-        if (!std::getline(ss, tweet)) continue;
-
-        DSString tweetDS(tweet.c_str());
-        std::vector<DSString> words;
-        tokenize(tweetDS, words);
-
-        int sentimentScore = 0;
-        for (const auto& word : words) {
-            auto it = wordSentiment.find(word);
-            if (it != wordSentiment.end()) {
-                sentimentScore += it->second;
-            }
-        }
+#if defined(SENTIMENT_HAVE_IO_URING)
+// Minimal io_uring wrapper over the raw system calls (no liburing): one
+// submission ring of read/write requests and its completion ring.
+class IoRing {
+public:
+    IoRing() = default;
+    ~IoRing();
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    bool init(unsigned entries);
+
+    // Queue a request; submit() hands every queued request to the kernel
+    void queueRead(int fd, char* buffer, unsigned length, uint64_t offset, uint64_t userData);
+    void queueWrite(int fd, const char* buffer, unsigned length, uint64_t offset, uint64_t userData);
+    bool submit();
+    // Block until a request completes; result is its byte count or -errno
+    bool wait(uint64_t& userData, int& result);
+
+private:
+    int ringFd = -1;
+    void* sqMap = MAP_FAILED;
+    void* cqMap = MAP_FAILED;
+    size_t sqMapBytes = 0;
+    size_t cqMapBytes = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqeBytes = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned queued = 0;
+
+    void queue(uint8_t opcode, int fd, const char* buffer, unsigned length, uint64_t offset, uint64_t userData);
+};
+
+IoRing::~IoRing() {
+    if (sqes != MAP_FAILED)
+        munmap(sqes, sqeBytes);
+    if (cqMap != MAP_FAILED)
+        munmap(cqMap, cqMapBytes);
+    if (sqMap != MAP_FAILED)
+        munmap(sqMap, sqMapBytes);
+    if (ringFd >= 0)
+        ::close(ringFd);
+}
+
+bool IoRing::init(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0)
+        return false;
+
+    sqMapBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqMapBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqeBytes = params.sq_entries * sizeof(io_uring_sqe);
+    sqMap = mmap(nullptr, sqMapBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    cqMap = mmap(nullptr, cqMapBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqeBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+    if (sqMap == MAP_FAILED || cqMap == MAP_FAILED || sqes == MAP_FAILED)
+        return false;
+
+    char* sq = static_cast<char*>(sqMap);
+    char* cq = static_cast<char*>(cqMap);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+void IoRing::queue(uint8_t opcode, int fd, const char* buffer, unsigned length, uint64_t offset, uint64_t userData) {
+    unsigned tail = *sqTail; // Only this thread advances the tail
+    unsigned index = tail & *sqMask;
+    io_uring_sqe& sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(buffer);
+    sqe.len = length;
+    sqe.off = offset;
+    sqe.user_data = userData;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    queued++;
+}
+
+void IoRing::queueRead(int fd, char* buffer, unsigned length, uint64_t offset, uint64_t userData) {
+    queue(IORING_OP_READ, fd, buffer, length, offset, userData);
+}
+
+void IoRing::queueWrite(int fd, const char* buffer, unsigned length, uint64_t offset, uint64_t userData) {
+    queue(IORING_OP_WRITE, fd, buffer, length, offset, userData);
+}
 
-        int predictedSentiment = (sentimentScore >= 0) ? 4 : 0;
-        results << predictedSentiment << ", " << id << std::endl;
+bool IoRing::submit() {
+    while (queued > 0) {
+        long submitted = syscall(__NR_io_uring_enter, ringFd, queued, 0, 0, nullptr, 0);
+        if (submitted < 0 && errno == EINTR)
+            continue;
+        if (submitted <= 0)
+            return false;
+        queued -= static_cast<unsigned>(submitted);
     }
+    return true;
+}
 
-    file.close();
-    results.close();
-    std::cout << "Prediction completed. Results saved to " << resultsFile << std::endl;
+bool IoRing::wait(uint64_t& userData, int& result) {
+    for (;;) {
+        unsigned head = *cqHead;
+        if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            userData = cqe.user_data;
+            result = cqe.res;
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+        if (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+            return false;
+    }
 }
+#else
+// Stub so the readers and writers compile where io_uring is unavailable;
+// init() fails and they use the pread/pwrite path
+class IoRing {
+public:
+    bool init(unsigned) { return false; }
+    void queueRead(int, char*, unsigned, uint64_t, uint64_t) {}
+    void queueWrite(int, const char*, unsigned, uint64_t, uint64_t) {}
+    bool submit() { return false; }
+    bool wait(uint64_t&, int&) { return false; }
+};
+#endif
 
-// Evaluation function
-void SentimentClassifier::evaluatePredictions(const std::string& groundTruthFile, const std::string& resultsFile, const std::string& accuracyFile) {
-    std::ifstream groundTruth(groundTruthFile);
-    std::ifstream results(resultsFile);
-    if (!groundTruth.is_open()) {
-        std::cerr << "Error opening ground truth file: " << groundTruthFile << std::endl;
-        exit(1);
+// Uring requested but not available: warn once and use Pread
+IoBackend startRing(IoBackend backend, std::unique_ptr<IoRing>& ring, unsigned entries) {
+    if (backend != IoBackend::Uring)
+        return backend;
+    ring.reset(new IoRing());
+    if (ring->init(entries))
+        return backend;
+    ring.reset();
+    static std::once_flag warned;
+    std::call_once(warned, [] { std::cerr << "io_uring unavailable, using pread/pwrite" << std::endl; });
+    return IoBackend::Pread;
+}
+
+// Splits a file into lines like std::getline: '\n' ends a line and is not
+// included, and a last line without a newline is still returned. The view
+// from next() stays valid until the following call.
+class LineReader {
+public:
+    LineReader() = default;
+    ~LineReader() { close(); }
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    bool open(const std::string& path, IoBackend requested);
+    bool next(std::string_view& line);
+    void close();
+
+private:
+    IoBackend backend = IoBackend::Stream;
+    std::ifstream stream;
+    std::string streamLine;
+
+    int fd = -1;
+    uint64_t fileSize = 0;
+    std::unique_ptr<IoRing> ring;
+    std::unique_ptr<char[]> buffers; // IO_READ_DEPTH chunks
+    std::vector<int64_t> filled; // Bytes read per slot; -1 while in flight
+    uint64_t submittedChunks = 0;
+    uint64_t currentChunk = 0;
+    bool haveChunk = false;
+    const char* pos = nullptr;
+    const char* end = nullptr;
+    std::string carry; // Start of a line that continues in the next chunk
+
+    uint64_t chunkCount() const { return (fileSize + IO_CHUNK_BYTES - 1) / IO_CHUNK_BYTES; }
+    char* slotBuffer(uint64_t chunk) const { return buffers.get() + (chunk % IO_READ_DEPTH) * IO_CHUNK_BYTES; }
+    size_t chunkBytes(uint64_t chunk) const { return static_cast<size_t>(std::min<uint64_t>(IO_CHUNK_BYTES, fileSize - chunk * IO_CHUNK_BYTES)); }
+    void queueChunk(uint64_t chunk);
+    bool loadNextChunk();
+};
+
+bool LineReader::open(const std::string& path, IoBackend requested) {
+    close();
+    backend = requested;
+    if (backend == IoBackend::Stream) {
+        stream.open(path);
+        return stream.is_open();
     }
-    if (!results.is_open()) {
-        std::cerr << "Error opening results file: " << resultsFile << std::endl;
-        exit(1);
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
     }
+    fileSize = static_cast<uint64_t>(st.st_size);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-    std::ofstream accuracyOut(accuracyFile);
-    if (!accuracyOut.is_open()) {
-        std::cerr << "Error opening accuracy file: " << accuracyFile << std::endl;
-        exit(1);
+    backend = startRing(backend, ring, IO_READ_DEPTH);
+    unsigned depth = (backend == IoBackend::Uring) ? IO_READ_DEPTH : 1;
+    buffers.reset(new char[depth * IO_CHUNK_BYTES]);
+    filled.assign(IO_READ_DEPTH, -1);
+    submittedChunks = 0;
+    currentChunk = 0;
+    haveChunk = false;
+    pos = end = nullptr;
+    carry.clear();
+
+    if (backend == IoBackend::Uring) {
+        while (submittedChunks < std::min<uint64_t>(IO_READ_DEPTH, chunkCount()))
+            queueChunk(submittedChunks++);
+        ring->submit();
     }
+    return true;
+}
 
-    // Read ground truth into a map
-    std::unordered_map<long, int> groundTruthMap;
-    std::string truthLine;
-    while (std::getline(groundTruth, truthLine)) {
-        std::stringstream ss(truthLine);
-        std::string sentimentStr, idStr;
-        if (!std::getline(ss, sentimentStr, ',')) continue;
-        if (!std::getline(ss, idStr, ',')) continue;
-        int sentiment;
-        long tweetID;
-        try {
-            sentiment = std::stoi(sentimentStr);
-            tweetID = std::stol(idStr);
-        }
-        catch (...) {
-            continue; // Invalid data
+void LineReader::queueChunk(uint64_t chunk) {
+    filled[chunk % IO_READ_DEPTH] = -1;
+    ring->queueRead(fd, slotBuffer(chunk), static_cast<unsigned>(chunkBytes(chunk)), chunk * IO_CHUNK_BYTES, chunk);
+}
+
+// Make the next chunk current; false at end of file
+bool LineReader::loadNextChunk() {
+    if (haveChunk) {
+        // The finished chunk's slot takes the next read
+        if (backend == IoBackend::Uring && submittedChunks < chunkCount()) {
+            queueChunk(submittedChunks++);
+            ring->submit();
         }
-        groundTruthMap[tweetID] = sentiment;
+        currentChunk++;
     }
-    groundTruth.close();
+    haveChunk = true;
+    if (currentChunk >= chunkCount())
+        return false;
 
-    // Read predictions
-    std::vector<std::pair<int, long>> predictions; // pair<predicted sentiment, tweetID>
-    std::string resultLine;
-    while (std::getline(results, resultLine)) {
-        std::stringstream ss(resultLine);
-        std::string sentimentStr, idStr;
-        if (!std::getline(ss, sentimentStr, ',')) continue;
-        if (!std::getline(ss, idStr, ',')) continue;
-        int sentiment;
-        long tweetID;
-        try {
-            sentiment = std::stoi(sentimentStr);
-            // Remove possible leading/trailing spaces from idStr
-            size_t start = idStr.find_first_not_of(" \t");
-            size_t end = idStr.find_last_not_of(" \t");
-            std::string trimmedId = (start == std::string::npos) ? "" : idStr.substr(start, end - start + 1);
-            tweetID = std::stol(trimmedId);
+    char* buffer = (backend == IoBackend::Uring) ? slotBuffer(currentChunk) : buffers.get();
+    size_t wanted = chunkBytes(currentChunk);
+    uint64_t offset = currentChunk * IO_CHUNK_BYTES;
+    size_t got = 0;
+    if (backend == IoBackend::Uring) {
+        int64_t& slot = filled[currentChunk % IO_READ_DEPTH];
+        while (slot < 0) {
+            uint64_t chunk;
+            int result;
+            if (!ring->wait(chunk, result)) {
+                std::cerr << "io_uring wait failed" << std::endl;
+                exit(1);
+            }
+            filled[chunk % IO_READ_DEPTH] = (result < 0) ? 0 : result; // Failed reads are redone below
         }
-        catch (...) {
-            continue; // Invalid data
+        got = static_cast<size_t>(slot);
+    }
+    if (got < wanted) { // Pread backend, or a short or failed asynchronous read
+        size_t more = 0;
+        if (!preadFully(fd, buffer + got, wanted - got, offset + got, more)) {
+            std::cerr << "Error reading input file" << std::endl;
+            exit(1);
         }
-        predictions.emplace_back(sentiment, tweetID);
+        got += more;
     }
-    results.close();
+    pos = buffer;
+    end = buffer + got;
+    return true;
+}
 
-    // Compare predictions with ground truth
-    int totalTweets = 0;
-    int correctPredictions = 0;
-    std::vector<std::tuple<int, int, long>> misclassifications; // ground truth, prediction, tweet ID
+bool LineReader::next(std::string_view& line) {
+    if (backend == IoBackend::Stream) {
+        if (!std::getline(stream, streamLine))
+            return false;
+        line = streamLine;
+        return true;
+    }
 
-    for (const auto& pred : predictions) {
-        int predicted = pred.first;
-        long tweetID = pred.second;
-        auto it = groundTruthMap.find(tweetID);
-        if (it != groundTruthMap.end()) {
-            int actual = it->second;
-            if (predicted == actual) {
-                correctPredictions++;
+    carry.clear();
+    for (;;) {
+        if (pos == end && !loadNextChunk()) {
+            if (carry.empty())
+                return false;
+            line = carry; // Last line has no newline
+            return true;
+        }
+        const char* newline = static_cast<const char*>(std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        if (newline) {
+            if (carry.empty()) {
+                line = std::string_view(pos, static_cast<size_t>(newline - pos)); // Zero-copy
             }
             else {
-                misclassifications.emplace_back(actual, predicted, tweetID);
+                carry.append(pos, static_cast<size_t>(newline - pos));
+                line = carry;
             }
-            totalTweets++;
+            pos = newline + 1;
+            return true;
         }
+        carry.append(pos, static_cast<size_t>(end - pos));
+        pos = end;
     }
+}
 
-    // Calculate accuracy
-    double accuracyValue = (totalTweets > 0) ? (static_cast<double>(correctPredictions) / totalTweets) * 100.0 : 0.0;
-
-    // Write accuracy first
-    accuracyOut << std::fixed << std::setprecision(3) << accuracyValue << std::endl;
-
-    // Write misclassifications
-    for (const auto& mis : misclassifications) {
-        accuracyOut << std::get<0>(mis) << ", " << std::get<1>(mis) << ", " << std::get<2>(mis) << std::endl;
+void LineReader::close() {
+    if (stream.is_open())
+        stream.close();
+    if (fd >= 0) {
+        // Drain reads still in flight before their buffers go away
+        if (ring) {
+            for (uint64_t chunk = currentChunk + (haveChunk ? 1 : 0); chunk < submittedChunks; ++chunk) {
+                while (filled[chunk % IO_READ_DEPTH] < 0) {
+                    uint64_t done;
+                    int result;
+                    if (!ring->wait(done, result))
+                        break;
+                    filled[done % IO_READ_DEPTH] = 0;
+                }
+            }
+        }
+        ::close(fd);
+        fd = -1;
     }
-
-    accuracyOut.close();
-    std::cout << "Evaluation completed. Accuracy saved to " << accuracyFile << std::endl;
+    ring.reset();
+}
+
+// Buffered output. Stream writes through std::ofstream; the other backends
+// collect IO_CHUNK_BYTES at a time and write each full buffer with pwrite,
+// or with io_uring while the next buffer fills.
+class LineWriter {
+public:
+    LineWriter() = default;
+    ~LineWriter() { close(); }
+    LineWriter(const LineWriter&) = delete;
+    LineWriter& operator=(const LineWriter&) = delete;
+
+    bool open(const std::string& path, IoBackend requested);
+    void write(std::string_view text);
+    void close();
+
+private:
+    IoBackend backend = IoBackend::Stream;
+    std::ofstream stream;
+
+    int fd = -1;
+    uint64_t offset = 0; // File offset of the filling buffer
+    std::unique_ptr<IoRing> ring;
+    std::unique_ptr<char[]> buffers; // IO_WRITE_DEPTH buffers
+    unsigned slot = 0;
+    size_t fill = 0;
+    uint64_t slotOffsets[IO_WRITE_DEPTH] = {};
+    size_t slotLengths[IO_WRITE_DEPTH] = {};
+    bool inFlight[IO_WRITE_DEPTH] = {};
+
+    char* slotBuffer(unsigned index) const { return buffers.get() + index * IO_CHUNK_BYTES; }
+    void flushBuffer();
+    void waitOne();
+};
+
+bool LineWriter::open(const std::string& path, IoBackend requested) {
+    close();
+    backend = requested;
+    if (backend == IoBackend::Stream) {
+        stream.open(path);
+        return stream.is_open();
+    }
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    backend = startRing(backend, ring, IO_WRITE_DEPTH);
+    unsigned depth = (backend == IoBackend::Uring) ? IO_WRITE_DEPTH : 1;
+    buffers.reset(new char[depth * IO_CHUNK_BYTES]);
+    offset = 0;
+    slot = 0;
+    fill = 0;
+    std::fill(inFlight, inFlight + IO_WRITE_DEPTH, false);
+    return true;
+}
+
+void LineWriter::write(std::string_view text) {
+    if (backend == IoBackend::Stream) {
+        stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+        return;
+    }
+    while (!text.empty()) {
+        size_t n = std::min(text.size(), IO_CHUNK_BYTES - fill);
+        std::memcpy(slotBuffer(slot) + fill, text.data(), n);
+        fill += n;
+        text.remove_prefix(n);
+        if (fill == IO_CHUNK_BYTES)
+            flushBuffer();
+    }
+}
+
+// Write out the filling buffer and move on to a free one
+void LineWriter::flushBuffer() {
+    if (fill == 0)
+        return;
+    if (backend != IoBackend::Uring) {
+        if (!pwriteFully(fd, slotBuffer(slot), fill, offset)) {
+            std::cerr << "Error writing output file" << std::endl;
+            exit(1);
+        }
+        offset += fill;
+        fill = 0;
+        return;
+    }
+
+    slotOffsets[slot] = offset;
+    slotLengths[slot] = fill;
+    inFlight[slot] = true;
+    ring->queueWrite(fd, slotBuffer(slot), static_cast<unsigned>(fill), offset, slot);
+    ring->submit();
+    offset += fill;
+    fill = 0;
+    slot = (slot + 1) % IO_WRITE_DEPTH;
+    while (inFlight[slot])
+        waitOne();
+}
+
+// Retire one completed write, finishing it with pwrite if it came up short
+void LineWriter::waitOne() {
+    uint64_t done;
+    int result;
+    if (!ring->wait(done, result)) {
+        std::cerr << "io_uring wait failed" << std::endl;
+        exit(1);
+    }
+    size_t written = (result < 0) ? 0 : static_cast<size_t>(result);
+    if (written < slotLengths[done] &&
+        !pwriteFully(fd, slotBuffer(static_cast<unsigned>(done)) + written, slotLengths[done] - written, slotOffsets[done] + written)) {
+        std::cerr << "Error writing output file" << std::endl;
+        exit(1);
+    }
+    inFlight[done] = false;
+}
+
+void LineWriter::close() {
+    if (stream.is_open())
+        stream.close();
+    if (fd >= 0) {
+        flushBuffer();
+        if (ring) {
+            for (unsigned i = 0; i < IO_WRITE_DEPTH; ++i) {
+                while (inFlight[i])
+                    waitOne();
+            }
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    ring.reset();
+}
+
+// ------------------- Columnar Dataset Format -------------------
+// Binary, mmappable alternative to the tweet CSVs. Each column is stored
+// contiguously so a phase only pages in the columns it reads:
+//
+//   ColumnarHeader
+//   id column        int64[rows]                          (COL_ID, always present)
+//   label column     uint8[rows]                          (COL_LABEL)
+//   text column      uint64 offsets[rows + 1], UTF-8 blob  (COL_TEXT)
+//   date column      uint64 offsets[rows + 1], UTF-8 blob  (COL_DATE)
+//   user column      uint64 offsets[rows + 1], UTF-8 blob  (COL_USER)
+//
+// All column offsets are relative to the start of the file and 8-byte aligned.
+enum ColumnFlags : uint32_t {
+    COL_LABEL = 1u << 0,
+    COL_TEXT = 1u << 1,
+    COL_DATE = 1u << 2,
+    COL_USER = 1u << 3,
+    COL_ID = 1u << 4 // Never stored in ColumnarHeader::columns; every file has ids
+};
+
+static const char COLUMNAR_MAGIC[8] = { 'D', 'S', 'C', 'O', 'L', 'v', '1', '\0' };
+
+struct StringColumnRef {
+    uint64_t offsets; // uint64[rows + 1], relative to blob
+    uint64_t blob;
+};
+
+struct ColumnarHeader {
+    char magic[8];
+    uint64_t rows;
+    uint32_t columns; // Bitmask of ColumnFlags
+    uint32_t reserved;
+    uint64_t ids;
+    uint64_t labels;
+    StringColumnRef text;
+    StringColumnRef date;
+    StringColumnRef user;
+};
+
+// ------------------- ColumnarDataset Class -------------------
+class ColumnarDataset {
+public:
+    // True if the file starts with the columnar magic bytes
+    static bool isColumnar(const std::string& path);
+
+    bool open(const std::string& path);
+
+    size_t rows() const { return static_cast<size_t>(header.rows); }
+    bool has(uint32_t columns) const { return ((header.columns | COL_ID) & columns) == columns; }
+
+    // Prefetch only the columns the current phase reads
+    void willNeed(uint32_t columns) const;
+
+    int64_t id(size_t row) const { return ids[row]; }
+    int label(size_t row) const { return labels[row]; }
+    std::string_view text(size_t row) const { return cell(header.text, row); }
+    std::string_view date(size_t row) const { return cell(header.date, row); }
+    std::string_view user(size_t row) const { return cell(header.user, row); }
+
+private:
+    MappedFile file;
+    ColumnarHeader header = {};
+    const int64_t* ids = nullptr;
+    const uint8_t* labels = nullptr;
+
+    std::string_view cell(const StringColumnRef& column, size_t row) const;
+    bool validStringColumn(const StringColumnRef& column) const;
+    // True if [offset, offset + bytes) lies inside the file, without overflow
+    bool fits(uint64_t offset, uint64_t bytes) const {
+        return offset <= file.length() && bytes <= file.length() - offset;
+    }
+};
+
+bool ColumnarDataset::isColumnar(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(COLUMNAR_MAGIC)] = {};
+    in.read(magic, sizeof(magic));
+    return in.gcount() == sizeof(magic) && std::memcmp(magic, COLUMNAR_MAGIC, sizeof(magic)) == 0;
+}
+
+bool ColumnarDataset::open(const std::string& path) {
+    if (!file.open(path) || file.length() < sizeof(ColumnarHeader))
+        return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)) != 0)
+        return false;
+
+    if (header.rows > file.length() / sizeof(int64_t) || !fits(header.ids, header.rows * sizeof(int64_t)))
+        return false;
+    ids = reinterpret_cast<const int64_t*>(file.data() + header.ids);
+
+    if (has(COL_LABEL)) {
+        if (!fits(header.labels, header.rows))
+            return false;
+        labels = reinterpret_cast<const uint8_t*>(file.data() + header.labels);
+    }
+
+    if ((has(COL_TEXT) && !validStringColumn(header.text)) ||
+        (has(COL_DATE) && !validStringColumn(header.date)) ||
+        (has(COL_USER) && !validStringColumn(header.user)))
+        return false;
+    return true;
+}
+
+// Offsets must start at 0, never decrease and end inside the blob, so every
+// cell() is in bounds without checks on the read path
+bool ColumnarDataset::validStringColumn(const StringColumnRef& column) const {
+    if (!fits(column.offsets, (header.rows + 1) * sizeof(uint64_t)) || !fits(column.blob, 0))
+        return false;
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file.data() + column.offsets);
+    if (offsets[0] != 0)
+        return false;
+    for (uint64_t row = 0; row < header.rows; ++row) {
+        if (offsets[row + 1] < offsets[row])
+            return false;
+    }
+    return fits(column.blob, offsets[header.rows]);
+}
+
+std::string_view ColumnarDataset::cell(const StringColumnRef& column, size_t row) const {
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file.data() + column.offsets);
+    return std::string_view(file.data() + column.blob + offsets[row], offsets[row + 1] - offsets[row]);
+}
+
+void ColumnarDataset::willNeed(uint32_t columns) const {
+    auto adviseStrings = [this](const StringColumnRef& column) {
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file.data() + column.offsets);
+        file.willNeed(column.offsets, (header.rows + 1) * sizeof(uint64_t));
+        file.willNeed(column.blob, offsets[header.rows]);
+    };
+    if (columns & COL_ID)
+        file.willNeed(header.ids, header.rows * sizeof(int64_t));
+    if ((columns & COL_LABEL) && has(COL_LABEL))
+        file.willNeed(header.labels, header.rows);
+    if ((columns & COL_TEXT) && has(COL_TEXT))
+        adviseStrings(header.text);
+    if ((columns & COL_DATE) && has(COL_DATE))
+        adviseStrings(header.date);
+    if ((columns & COL_USER) && has(COL_USER))
+        adviseStrings(header.user);
+}
+
+// Split a CSV line the same way the std::getline(ss, field, ',') chains do:
+// the first count - 1 fields end at a comma and the last field takes the rest
+// of the line. Returns false if the line runs out of fields.
+bool splitCsvFields(std::string_view line, std::string_view* fields, size_t count) {
+    size_t pos = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (pos >= line.size())
+            return false;
+        if (i + 1 == count) {
+            fields[i] = line.substr(pos);
+            break;
+        }
+        size_t comma = line.find(',', pos);
+        if (comma == std::string_view::npos)
+            comma = line.size();
+        fields[i] = line.substr(pos, comma - pos);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+// Convert a tweet CSV into the columnar format. Layouts:
+//   train: Sentiment,id,Date,Query,User,Tweet
+//   test:  id,Date,Query,User,Tweet
+//   truth: Sentiment,id
+// Rows whose sentiment or id do not parse (such as header lines) are skipped.
+void convertToColumnar(const std::string& layout, const std::string& inputFile, const std::string& outputFile, bool keepMeta) {
+    bool hasLabel = (layout == "train" || layout == "truth");
+    bool hasText = (layout == "train" || layout == "test");
+    if (!hasLabel && !hasText) {
+        std::cerr << "Unknown CSV layout: " << layout << " (expected train, test or truth)" << std::endl;
+        exit(1);
+    }
+
+    std::ifstream in(inputFile);
+    if (!in.is_open()) {
+        std::cerr << "Error opening input file: " << inputFile << std::endl;
+        exit(1);
+    }
+
+    struct StringColumn {
+        std::vector<uint64_t> offsets{ 0 };
+        std::string blob;
+        void append(std::string_view value) {
+            blob.append(value.data(), value.size());
+            offsets.push_back(blob.size());
+        }
+    };
+
+    std::vector<int64_t> ids;
+    std::vector<uint8_t> labels;
+    StringColumn text, date, user;
+
+    size_t fieldCount = (layout == "train") ? 6 : (layout == "test") ? 5 : 2;
+    std::string_view fields[6];
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!splitCsvFields(line, fields, fieldCount))
+            continue;
+        size_t idField = hasLabel ? 1 : 0;
+
+        int sentiment = 0;
+        int64_t tweetID;
+        try {
+            if (hasLabel)
+                sentiment = std::stoi(std::string(fields[0]));
+            tweetID = std::stoll(std::string(fields[idField]));
+        }
+        catch (...) {
+            continue; // Header or malformed row
+        }
+        if (sentiment < 0 || sentiment > 255)
+            continue;
+
+        ids.push_back(tweetID);
+        if (hasLabel)
+            labels.push_back(static_cast<uint8_t>(sentiment));
+        if (hasText) {
+            text.append(fields[idField + 4]);
+            if (keepMeta) {
+                date.append(fields[idField + 1]);
+                user.append(fields[idField + 3]);
+            }
+        }
+    }
+    in.close();
+
+    ColumnarHeader header = {};
+    std::memcpy(header.magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+    header.rows = ids.size();
+    header.columns = (hasLabel ? COL_LABEL : 0u) | (hasText ? COL_TEXT : 0u) |
+                     ((hasText && keepMeta) ? (COL_DATE | COL_USER) : 0u);
+
+    // Lay the columns out back to back, each starting on an 8-byte boundary
+    uint64_t cursor = sizeof(ColumnarHeader);
+    auto place = [&cursor](uint64_t bytes) {
+        cursor = (cursor + 7) & ~uint64_t(7);
+        uint64_t at = cursor;
+        cursor += bytes;
+        return at;
+    };
+    auto placeStrings = [&place](const StringColumn& column) {
+        StringColumnRef ref;
+        ref.offsets = place(column.offsets.size() * sizeof(uint64_t));
+        ref.blob = place(column.blob.size());
+        return ref;
+    };
+    header.ids = place(ids.size() * sizeof(int64_t));
+    if (header.columns & COL_LABEL)
+        header.labels = place(labels.size());
+    if (header.columns & COL_TEXT)
+        header.text = placeStrings(text);
+    if (header.columns & COL_DATE)
+        header.date = placeStrings(date);
+    if (header.columns & COL_USER)
+        header.user = placeStrings(user);
+
+    std::ofstream out(outputFile, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error opening output file: " << outputFile << std::endl;
+        exit(1);
+    }
+    uint64_t written = 0;
+    auto writeAt = [&out, &written](uint64_t offset, const void* bytes, uint64_t length) {
+        static const char padding[8] = {};
+        out.write(padding, static_cast<std::streamsize>(offset - written));
+        out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(length));
+        written = offset + length;
+    };
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.ids, ids.data(), ids.size() * sizeof(int64_t));
+    if (header.columns & COL_LABEL)
+        writeAt(header.labels, labels.data(), labels.size());
+    auto writeStrings = [&writeAt](const StringColumnRef& ref, const StringColumn& column) {
+        writeAt(ref.offsets, column.offsets.data(), column.offsets.size() * sizeof(uint64_t));
+        writeAt(ref.blob, column.blob.data(), column.blob.size());
+    };
+    if (header.columns & COL_TEXT)
+        writeStrings(header.text, text);
+    if (header.columns & COL_DATE)
+        writeStrings(header.date, date);
+    if (header.columns & COL_USER)
+        writeStrings(header.user, user);
+    out.close();
+
+    std::cout << "Conversion completed. " << header.rows << " rows written to " << outputFile << std::endl;
+}
+
+#endif // SENTIMENT_LIBRARY
+
+// -------------------- Tokenization Pipeline --------------------
+// Tokenization pipeline options. The flags are stored in model files so a
+// model is always scored with the pipeline it was trained with; 0 is the
+// original pipeline (lowercase, stem, drop stop words, unigrams only).
+enum PipelineFlags : uint32_t {
+    PIPELINE_NO_LOWERCASE = 1u << 0,
+    PIPELINE_NO_STEM = 1u << 1,
+    PIPELINE_NO_STOP_WORDS = 1u << 2,
+    PIPELINE_BIGRAMS = 1u << 3, // Also emit "previous current" for adjacent terms
+    PIPELINE_ALL = (1u << 4) - 1
+};
+
+// Compile-time form of a flag set. Every hot loop is a template over this
+// policy so each configuration gets its own inlined loop with no per-byte or
+// per-token option checks; dispatchPipeline picks the instantiation.
+template <uint32_t Flags>
+struct Pipeline {
+    static constexpr uint32_t flags = Flags;
+    static constexpr bool lowercase = !(Flags & PIPELINE_NO_LOWERCASE);
+    static constexpr bool stem = !(Flags & PIPELINE_NO_STEM);
+    static constexpr bool stopWords = !(Flags & PIPELINE_NO_STOP_WORDS);
+    static constexpr bool bigrams = (Flags & PIPELINE_BIGRAMS) != 0;
+};
+using DefaultPipeline = Pipeline<0>;
+
+// Calls callback(Pipeline<flags>()) for a runtime flag set
+template <uint32_t Flags = 0, typename Callback>
+void dispatchPipeline(uint32_t flags, Callback&& callback) {
+    if constexpr (Flags < PIPELINE_ALL) {
+        if (flags != Flags) {
+            dispatchPipeline<Flags + 1>(flags, std::forward<Callback>(callback));
+            return;
+        }
+    }
+    callback(Pipeline<Flags>());
+}
+
+#ifndef SENTIMENT_LIBRARY
+// Human-readable flag list for log messages
+std::string describePipeline(uint32_t flags) {
+    std::string description = (flags & PIPELINE_NO_LOWERCASE) ? "case-sensitive" : "lowercase";
+    description += (flags & PIPELINE_NO_STEM) ? ", no stemming" : ", stemmed";
+    description += (flags & PIPELINE_NO_STOP_WORDS) ? ", stop words kept" : ", stop words dropped";
+    description += (flags & PIPELINE_BIGRAMS) ? ", unigrams + bigrams" : ", unigrams";
+    return description;
+}
+#endif // SENTIMENT_LIBRARY
+
+// ----------------------- Model Files -----------------------
+// Sorted (term, count) lists used for partial and merged models:
+//
+//   char[8]  magic "DSMDLv2\0"
+//   uint64   entry count
+//   uint32   pipeline flags (see PipelineFlags)
+//   uint32   entry flags (MODEL_OCCURRENCES)
+//   entries  uint32 term length, term bytes, int32 count,
+//            then uint32 training occurrences if MODEL_OCCURRENCES is set
+//
+// Version 1 files have neither flags word and are read as the default
+// pipeline without occurrences.
+// Terms are ordered bytewise (unsigned), which lets any number of model
+// files be combined with a streaming k-way merge.
+//
+// Logistic regression models use the same entries with a float weight in
+// place of the count, and carry the bias after the entry count:
+//
+//   char[8]  magic "DSLOGv2\0"
+//   uint64   entry count
+//   float    bias
+//   uint32   pipeline flags
+//   uint32   entry flags
+//   entries  uint32 term length, term bytes, float weight[, uint32 occurrences]
+//
+// Version 1 logistic files have no entry flags word.
+// Readers turn float weights into int32 fixed point (LOGISTIC_SCALE units),
+// so every scoring path can treat both kinds of model as integer weights.
+static const char MODEL_MAGIC[8] = { 'D', 'S', 'M', 'D', 'L', 'v', '2', '\0' };
+static const char MODEL_MAGIC_V1[8] = { 'D', 'S', 'M', 'D', 'L', 'v', '1', '\0' };
+static const char LOGISTIC_MAGIC[8] = { 'D', 'S', 'L', 'O', 'G', 'v', '2', '\0' };
+static const char LOGISTIC_MAGIC_V1[8] = { 'D', 'S', 'L', 'O', 'G', 'v', '1', '\0' };
+static const uint32_t MODEL_OCCURRENCES = 1u << 0; // Entry flag: per-term training occurrences follow each value
+static const uint32_t MAX_MODEL_TERM_BYTES = 1u << 16; // Longer term lengths mean a damaged file
+static const double LOGISTIC_SCALE = 65536.0;
+
+inline int32_t toFixedPoint(float weight) {
+    return static_cast<int32_t>(std::lround(static_cast<double>(weight) * LOGISTIC_SCALE));
+}
+
+#ifndef SENTIMENT_LIBRARY
+// Bytewise term order shared by every writer and the merge
+inline bool termLess(const char* a, size_t aLen, const char* b, size_t bLen) {
+    int cmp = std::memcmp(a, b, std::min(aLen, bLen));
+    return (cmp != 0) ? (cmp < 0) : (aLen < bLen);
+}
+
+class ModelWriter {
+public:
+    // With withOccurrences every entry also records its training occurrences
+    bool open(const std::string& path, uint32_t pipeline, bool withOccurrences);
+    bool openLogistic(const std::string& path, float bias, uint32_t pipeline, bool withOccurrences);
+    void write(const char* term, uint32_t length, int32_t count, uint32_t occurrences = 0);
+    void writeWeight(const char* term, uint32_t length, float weight, uint32_t occurrences = 0); // Logistic models only
+    void close(); // Patches the entry count into the header
+
+    uint64_t entries() const { return written; }
+
+private:
+    std::ofstream out;
+    uint64_t written = 0;
+    bool occurrences = false;
+
+    void writeEntry(const char* term, uint32_t length, const void* value, uint32_t occurrenceCount);
+};
+
+bool ModelWriter::open(const std::string& path, uint32_t pipeline, bool withOccurrences) {
+    out.open(path, std::ios::binary);
+    if (!out.is_open())
+        return false;
+    written = 0;
+    occurrences = withOccurrences;
+    uint32_t entryFlags = withOccurrences ? MODEL_OCCURRENCES : 0;
+    out.write(MODEL_MAGIC, sizeof(MODEL_MAGIC));
+    out.write(reinterpret_cast<const char*>(&written), sizeof(written));
+    out.write(reinterpret_cast<const char*>(&pipeline), sizeof(pipeline));
+    out.write(reinterpret_cast<const char*>(&entryFlags), sizeof(entryFlags));
+    return true;
+}
+
+bool ModelWriter::openLogistic(const std::string& path, float bias, uint32_t pipeline, bool withOccurrences) {
+    out.open(path, std::ios::binary);
+    if (!out.is_open())
+        return false;
+    written = 0;
+    occurrences = withOccurrences;
+    uint32_t entryFlags = withOccurrences ? MODEL_OCCURRENCES : 0;
+    out.write(LOGISTIC_MAGIC, sizeof(LOGISTIC_MAGIC));
+    out.write(reinterpret_cast<const char*>(&written), sizeof(written));
+    out.write(reinterpret_cast<const char*>(&bias), sizeof(bias));
+    out.write(reinterpret_cast<const char*>(&pipeline), sizeof(pipeline));
+    out.write(reinterpret_cast<const char*>(&entryFlags), sizeof(entryFlags));
+    return true;
+}
+
+void ModelWriter::writeEntry(const char* term, uint32_t length, const void* value, uint32_t occurrenceCount) {
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(term, length);
+    out.write(static_cast<const char*>(value), 4);
+    if (occurrences)
+        out.write(reinterpret_cast<const char*>(&occurrenceCount), sizeof(occurrenceCount));
+    written++;
+}
+
+void ModelWriter::writeWeight(const char* term, uint32_t length, float weight, uint32_t occurrences) {
+    writeEntry(term, length, &weight, occurrences);
+}
+
+void ModelWriter::write(const char* term, uint32_t length, int32_t count, uint32_t occurrences) {
+    writeEntry(term, length, &count, occurrences);
+}
+
+void ModelWriter::close() {
+    out.seekp(sizeof(MODEL_MAGIC));
+    out.write(reinterpret_cast<const char*>(&written), sizeof(written));
+    out.close();
+}
+#endif // SENTIMENT_LIBRARY
+
+class ModelReader {
+public:
+    bool open(const std::string& path);
+    bool next(); // Advance to the next entry; false at the end or on a damaged entry
+    bool truncated() const { return damaged; } // next() stopped before entries()
+
+    const std::string& term() const { return currentTerm; }
+    int32_t count() const { return currentCount; } // Fixed point for logistic models
+    uint64_t entries() const { return total; }
+    bool logistic() const { return isLogistic; }
+    int32_t bias() const { return fixedBias; } // Fixed point; 0 for count models
+    uint32_t pipeline() const { return pipelineFlags; }
+    bool hasOccurrences() const { return (entryFlags & MODEL_OCCURRENCES) != 0; }
+    uint32_t occurrences() const { return currentOccurrences; } // 0 unless hasOccurrences()
+
+private:
+    std::ifstream in;
+    uint64_t total = 0;
+    uint64_t consumed = 0;
+    std::string currentTerm;
+    int32_t currentCount = 0;
+    bool isLogistic = false;
+    int32_t fixedBias = 0;
+    uint32_t pipelineFlags = 0;
+    uint32_t entryFlags = 0;
+    uint32_t currentOccurrences = 0;
+    bool damaged = false;
+};
+
+bool ModelReader::open(const std::string& path) {
+    in.open(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+    char magic[sizeof(MODEL_MAGIC)] = {};
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&total), sizeof(total));
+    consumed = 0;
+    damaged = false;
+    bool logisticV1 = (std::memcmp(magic, LOGISTIC_MAGIC_V1, sizeof(magic)) == 0);
+    isLogistic = logisticV1 || (std::memcmp(magic, LOGISTIC_MAGIC, sizeof(magic)) == 0);
+    fixedBias = 0;
+    pipelineFlags = 0;
+    entryFlags = 0;
+    currentOccurrences = 0;
+    if (isLogistic) {
+        float bias = 0;
+        in.read(reinterpret_cast<char*>(&bias), sizeof(bias));
+        in.read(reinterpret_cast<char*>(&pipelineFlags), sizeof(pipelineFlags));
+        if (!logisticV1)
+            in.read(reinterpret_cast<char*>(&entryFlags), sizeof(entryFlags));
+        fixedBias = toFixedPoint(bias);
+    }
+    else if (std::memcmp(magic, MODEL_MAGIC, sizeof(magic)) == 0) {
+        in.read(reinterpret_cast<char*>(&pipelineFlags), sizeof(pipelineFlags));
+        in.read(reinterpret_cast<char*>(&entryFlags), sizeof(entryFlags));
+    }
+    else if (std::memcmp(magic, MODEL_MAGIC_V1, sizeof(magic)) != 0) {
+        return false;
+    }
+    return in.good() && (pipelineFlags & ~PIPELINE_ALL) == 0 && (entryFlags & ~MODEL_OCCURRENCES) == 0;
+}
+
+bool ModelReader::next() {
+    if (consumed == total || damaged)
+        return false;
+    uint32_t length = 0;
+    in.read(reinterpret_cast<char*>(&length), sizeof(length));
+    if (!in || length > MAX_MODEL_TERM_BYTES) {
+        damaged = true;
+        return false;
+    }
+    currentTerm.resize(length);
+    in.read(&currentTerm[0], length);
+    in.read(reinterpret_cast<char*>(&currentCount), sizeof(currentCount));
+    if (hasOccurrences())
+        in.read(reinterpret_cast<char*>(&currentOccurrences), sizeof(currentOccurrences));
+    if (isLogistic) {
+        float weight;
+        std::memcpy(&weight, &currentCount, sizeof(weight));
+        currentCount = toFixedPoint(weight);
+    }
+    if (!in) {
+        damaged = true;
+        return false;
+    }
+    consumed++;
+    return true;
+}
+
+#ifndef SENTIMENT_LIBRARY
+// Read every entry of an opened model, exiting if the file is damaged
+template <typename Callback>
+void readModelEntries(ModelReader& reader, const std::string& path, Callback&& callback) {
+    while (reader.next())
+        callback();
+    if (reader.truncated()) {
+        std::cerr << "Truncated model file: " << path << std::endl;
+        exit(1);
+    }
+}
+
+// Sum the counts of any number of sorted model files into one, streaming
+// through them with a k-way merge so only one entry per input is in memory
+uint64_t mergeModelFiles(const std::vector<std::string>& inputFiles, const std::string& outputFile) {
+    std::vector<std::unique_ptr<ModelReader>> readers;
+    for (const auto& inputFile : inputFiles) {
+        readers.emplace_back(new ModelReader());
+        if (!readers.back()->open(inputFile)) {
+            std::cerr << "Error opening model file: " << inputFile << std::endl;
+            exit(1);
+        }
+        if (readers.back()->logistic()) {
+            std::cerr << "Cannot merge logistic regression model: " << inputFile << std::endl;
+            exit(1);
+        }
+        if (readers.back()->pipeline() != readers.front()->pipeline()) {
+            std::cerr << "Cannot merge models trained with different pipelines: " << inputFile
+                      << " (" << describePipeline(readers.back()->pipeline()) << ", expected "
+                      << describePipeline(readers.front()->pipeline()) << ")" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Min-heap of reader indices ordered by their current term
+    auto greater = [&readers](size_t a, size_t b) {
+        const std::string& termA = readers[a]->term();
+        const std::string& termB = readers[b]->term();
+        return termLess(termB.data(), termB.size(), termA.data(), termA.size());
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < readers.size(); ++i) {
+        if (readers[i]->next())
+            heap.push(i);
+    }
+
+    // Occurrences survive the merge only if every input has them
+    bool withOccurrences = !readers.empty();
+    for (const auto& reader : readers)
+        withOccurrences = withOccurrences && reader->hasOccurrences();
+
+    ModelWriter writer;
+    if (!writer.open(outputFile, readers.empty() ? 0 : readers.front()->pipeline(), withOccurrences)) {
+        std::cerr << "Error opening model file: " << outputFile << std::endl;
+        exit(1);
+    }
+
+    std::string term;
+    while (!heap.empty()) {
+        term = readers[heap.top()]->term();
+        int32_t count = 0;
+        uint64_t occurrences = 0;
+        while (!heap.empty() && readers[heap.top()]->term() == term) {
+            size_t reader = heap.top();
+            heap.pop();
+            count += readers[reader]->count();
+            occurrences += readers[reader]->occurrences();
+            if (readers[reader]->next())
+                heap.push(reader);
+        }
+        writer.write(term.data(), static_cast<uint32_t>(term.size()), count,
+                     static_cast<uint32_t>(std::min<uint64_t>(occurrences, UINT32_MAX)));
+    }
+    for (size_t i = 0; i < readers.size(); ++i) {
+        if (readers[i]->truncated()) {
+            std::cerr << "Truncated model file: " << inputFiles[i] << std::endl;
+            exit(1);
+        }
+    }
+    writer.close();
+    return writer.entries();
+}
+
+// ------------------- PredictionCache Class -------------------
+// 64-bit hash of raw tweet text, so duplicates can be recognized without
+// tokenizing them
+uint64_t hashText(std::string_view text) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = text.size() * multiplier;
+    size_t i = 0;
+    for (; i + 8 <= text.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, text.data() + i, sizeof(word));
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, text.data() + i, text.size() - i);
+    hash = (hash ^ tail) * multiplier;
+    hash ^= hash >> 32;
+    hash *= 0xD6E8FEB86659FD93ull;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Bounded cache from text hash to score. Entries live in 8-way sets; a miss
+// replaces a victim chosen by CLOCK within the set (second chance for
+// entries hit since the hand last passed). Sets are guarded by striped
+// mutexes so prediction threads can share one cache.
+class PredictionCache {
+public:
+    explicit PredictionCache(size_t capacity);
+
+    bool lookup(uint64_t hash, int& score);
+    void insert(uint64_t hash, int score);
+
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+    size_t capacity() const { return entries.size(); }
+
+private:
+    static const size_t WAYS = 8;
+    static const size_t LOCKS = 64;
+
+    struct Entry {
+        uint64_t hash = 0; // 0 marks an unused entry
+        int32_t score = 0;
+        bool referenced = false;
+    };
+
+    std::vector<Entry> entries; // sets * WAYS
+    std::vector<uint8_t> hands; // CLOCK position per set
+    size_t setMask;
+    std::mutex locks[LOCKS];
+    std::atomic<uint64_t> hitCount{ 0 };
+    std::atomic<uint64_t> missCount{ 0 };
+
+    size_t setOf(uint64_t hash) const { return static_cast<size_t>(hash >> 32) & setMask; }
+};
+
+PredictionCache::PredictionCache(size_t capacity) {
+    size_t sets = 1;
+    while (sets * WAYS < capacity)
+        sets *= 2;
+    entries.resize(sets * WAYS);
+    hands.assign(sets, 0);
+    setMask = sets - 1;
+}
+
+bool PredictionCache::lookup(uint64_t hash, int& score) {
+    hash |= 1; // Keep 0 free for unused entries
+    size_t set = setOf(hash);
+    std::lock_guard<std::mutex> guard(locks[set % LOCKS]);
+    Entry* ways = &entries[set * WAYS];
+    for (size_t i = 0; i < WAYS; ++i) {
+        if (ways[i].hash == hash) {
+            ways[i].referenced = true;
+            score = ways[i].score;
+            hitCount.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    missCount.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void PredictionCache::insert(uint64_t hash, int score) {
+    hash |= 1;
+    size_t set = setOf(hash);
+    std::lock_guard<std::mutex> guard(locks[set % LOCKS]);
+    Entry* ways = &entries[set * WAYS];
+    for (size_t i = 0; i < WAYS; ++i) {
+        if (ways[i].hash == hash)
+            return; // Another thread got there first
+    }
+    uint8_t& hand = hands[set];
+    while (ways[hand].hash != 0 && ways[hand].referenced) {
+        ways[hand].referenced = false;
+        hand = static_cast<uint8_t>((hand + 1) % WAYS);
+    }
+    ways[hand].hash = hash;
+    ways[hand].score = score;
+    ways[hand].referenced = false;
+    hand = static_cast<uint8_t>((hand + 1) % WAYS);
+}
+
+// ----------------------- Term Statistics -----------------------
+// What training learns about one term
+struct TermStats {
+    int sentiment = 0; // Positive count if > 0, negative if < 0 (fixed-point weight for logistic models)
+    uint32_t occurrences = 0; // Training tokens of the term; 0 if the model file does not record them
+};
+
+// ------------------- TermTable Class -------------------
+// Term statistics keyed by term text. A slot holds only the term's offset
+// and length in one pooled key array, so a new term appends its bytes to
+// the pool instead of allocating a DSString, and clearing or spilling the
+// table frees two arrays rather than one heap block per term.
+struct TermKey {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Hash and equality for TermKeys that read the pool; std::string_view
+// probes hash the same as DSStringHash
+struct TermKeyHash {
+    const std::vector<char>* keys;
+    size_t operator()(const TermKey& key) const { return hashChars(keys->data() + key.offset, key.length); }
+    size_t operator()(std::string_view term) const { return hashChars(term.data(), term.size()); }
+};
+
+struct TermKeyEqual {
+    const std::vector<char>* keys;
+    bool operator()(const TermKey& a, const TermKey& b) const {
+        return a.length == b.length && std::memcmp(keys->data() + a.offset, keys->data() + b.offset, a.length) == 0;
+    }
+    bool operator()(const TermKey& a, std::string_view b) const {
+        return a.length == b.size() && std::memcmp(keys->data() + a.offset, b.data(), b.size()) == 0;
+    }
+};
+
+class TermTable {
+public:
+    using Map = DSHashMap<TermKey, TermStats, TermKeyHash, TermKeyEqual>;
+    using value_type = Map::value_type;
+
+    TermTable() : stats(TermKeyHash{ &keys }, TermKeyEqual{ &keys }) {}
+    TermTable(const TermTable&) = delete;
+    TermTable& operator=(const TermTable&) = delete;
+
+    // nullptr for unknown terms
+    TermStats* find(std::string_view term) {
+        auto it = stats.find(term);
+        return (it != stats.end()) ? &it->second : nullptr;
+    }
+    const TermStats* find(std::string_view term) const {
+        auto it = stats.find(term);
+        return (it != stats.end()) ? &it->second : nullptr;
+    }
+
+    // Entry of term, added with empty stats if it is new
+    TermStats& operator[](std::string_view term);
+
+    // Split lookup: hash terms up front, prefetch their probe, then look up
+    // with the saved hash; weightOf gives the term's sentiment, 0 if unknown
+    size_t hash(std::string_view term) const { return stats.hashKey(term); }
+    void prefetch(size_t hash) const { stats.prefetch(hash); }
+    int32_t weightOf(std::string_view term, size_t hash) const {
+        auto it = stats.find(term, hash);
+        return (it != stats.end()) ? it->second.sentiment : 0;
+    }
+
+    // Entries are (TermKey, TermStats) pairs; term() gives a key's text
+    Map::const_iterator begin() const { return stats.begin(); }
+    Map::const_iterator end() const { return stats.end(); }
+    std::string_view term(const TermKey& key) const { return std::string_view(keys.data() + key.offset, key.length); }
+
+    size_t size() const { return stats.size(); }
+    bool empty() const { return stats.empty(); }
+    void reserve(size_t terms) { stats.reserve(terms); }
+    void clear() {
+        stats.clear();
+        keys.clear();
+    }
+    // Free the slots and the pool, not just empty them
+    void release() {
+        stats = Map(TermKeyHash{ &keys }, TermKeyEqual{ &keys });
+        std::vector<char>().swap(keys);
+    }
+
+    // Bytes held by the slots, by the pool, and both
+    size_t slotBytes() const { return stats.memoryBytes(); }
+    size_t keyBytes() const { return keys.capacity(); }
+    size_t memoryBytes() const { return slotBytes() + keyBytes(); }
+    // New terms that fit before the slots grow; key bytes before the pool grows
+    size_t insertsBeforeGrowth() const { return stats.insertsBeforeGrowth(); }
+    size_t keyBytesBeforeGrowth() const { return keys.capacity() - keys.size(); }
+
+private:
+    std::vector<char> keys;
+    Map stats;
+};
+
+TermStats& TermTable::operator[](std::string_view term) {
+    auto it = stats.find(term);
+    if (it != stats.end())
+        return it->second;
+    if (term.size() > std::numeric_limits<uint32_t>::max() - keys.size()) {
+        std::cerr << "Vocabulary too large for one term table; train with --memory-budget" << std::endl;
+        exit(1);
+    }
+    TermKey key{ static_cast<uint32_t>(keys.size()), static_cast<uint32_t>(term.size()) };
+    keys.insert(keys.end(), term.begin(), term.end());
+    return stats.try_emplace(key).first->second;
+}
+
+#endif // SENTIMENT_LIBRARY
+
+// ------------------- VocabularyIndex Class -------------------
+// Maps each term to a dense ID so per-term data can live in flat arrays
+class VocabularyIndex {
+public:
+    static const uint32_t npos = 0xFFFFFFFFu;
+
+    // Returns the ID of the term, assigning the next free one if it is new
+    uint32_t add(const DSString& term) {
+        auto inserted = ids.try_emplace(term, static_cast<uint32_t>(ids.size()));
+        return inserted.first->second;
+    }
+
+    // Accepts a DSString or a std::string_view
+    template <typename Term>
+    uint32_t lookup(const Term& term) const {
+        auto it = ids.find(term);
+        return (it != ids.end()) ? it->second : npos;
+    }
+
+    size_t size() const { return ids.size(); }
+    void reserve(size_t count) { ids.reserve(count); }
+
+private:
+    DSHashMap<DSString, uint32_t, DSStringHash, DSStringEqual> ids;
+};
+
+#ifndef SENTIMENT_LIBRARY
+// ------------------- QuantizedModel Class -------------------
+// Clamp saturates each count to the weight range; Scale divides every count
+// by a common factor so the largest magnitude just fits.
+enum class QuantizationMode { Clamp, Scale };
+
+// Word sentiments stored as int8_t or int16_t in a compact linear-probing
+// table. An 8-byte slot holds a 16-bit hash tag, the term length and the
+// term's offset in one pooled key array; the weights sit in an array
+// parallel to the slots. A probe compares key bytes only on a tag match,
+// so lookups never chase per-key heap blocks and the table is a fraction
+// of the size of the DSHashMap of counts. Scores are accumulated in int32_t.
+template <typename Weight>
+class QuantizedModel {
+public:
+    void build(const TermTable& counts, QuantizationMode mode);
+
+    size_t size() const { return count; }
+    // Everything a lookup can touch: slots, weights and pooled keys
+    size_t memoryBytes() const { return slots.size() * (sizeof(Slot) + sizeof(Weight)) + keys.size(); }
+    size_t saturatedCount() const { return saturated; }
+    // 0 for unknown terms
+    int32_t weightOf(std::string_view term) const { return weightOf(term, hashText(term)); }
+    int scaleFactor() const { return divisor; }
+
+    // Split lookup with a hash computed earlier by hash(), after prefetch(hash)
+    uint64_t hash(std::string_view term) const { return hashText(term); }
+    void prefetch(uint64_t hash) const {
+        __builtin_prefetch(&slots[hash & mask]);
+        __builtin_prefetch(&weights[hash & mask]);
+    }
+    int32_t weightOf(std::string_view term, uint64_t hash) const;
+
+private:
+    struct Slot {
+        uint32_t keyOffset;
+        uint16_t tag;
+        uint16_t length; // 0 marks an empty slot
+    };
+
+    std::vector<Slot> slots;
+    std::vector<Weight> weights; // Parallel to slots
+    std::vector<char> keys;
+    size_t mask = 0;
+    size_t count = 0;
+    size_t saturated = 0;
+    int divisor = 1;
+};
+
+template <typename Weight>
+void QuantizedModel<Weight>::build(const TermTable& counts, QuantizationMode mode) {
+    const long maxWeight = std::numeric_limits<Weight>::max();
+    const long minWeight = std::numeric_limits<Weight>::min();
+
+    divisor = 1;
+    if (mode == QuantizationMode::Scale) {
+        long maxAbs = 0;
+        for (const auto& entry : counts)
+            maxAbs = std::max(maxAbs, std::labs(static_cast<long>(entry.second.sentiment)));
+        divisor = static_cast<int>((maxAbs + maxWeight - 1) / maxWeight);
+        if (divisor < 1)
+            divisor = 1;
+    }
+
+    size_t capacity = 16; // At most 7/8 full
+    while (capacity * 7 < counts.size() * 8)
+        capacity *= 2;
+    slots.assign(capacity, Slot{ 0, 0, 0 });
+    weights.assign(capacity, 0);
+    keys.clear();
+    mask = capacity - 1;
+    count = 0;
+    saturated = 0;
+    for (const auto& entry : counts) {
+        std::string_view term = counts.term(entry.first);
+        if (term.empty() || term.size() > std::numeric_limits<uint16_t>::max())
+            continue; // The scanner never produces these
+        if (keys.size() + term.size() > std::numeric_limits<uint32_t>::max()) {
+            std::cerr << "Model terms too large to quantize" << std::endl;
+            exit(1);
+        }
+
+        long value = entry.second.sentiment;
+        if (divisor > 1) // Round half away from zero
+            value = (value >= 0) ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor);
+        if (value > maxWeight || value < minWeight) {
+            value = (value > maxWeight) ? maxWeight : minWeight;
+            saturated++;
+        }
+
+        uint64_t hash = hashText(term);
+        size_t index = hash & mask;
+        while (slots[index].length != 0) // Keys of a TermTable are unique
+            index = (index + 1) & mask;
+        slots[index] = Slot{ static_cast<uint32_t>(keys.size()), static_cast<uint16_t>(hash >> 48),
+                             static_cast<uint16_t>(term.size()) };
+        weights[index] = static_cast<Weight>(value);
+        keys.insert(keys.end(), term.begin(), term.end());
+        count++;
+    }
+}
+
+template <typename Weight>
+int32_t QuantizedModel<Weight>::weightOf(std::string_view term, uint64_t hash) const {
+    uint16_t tag = static_cast<uint16_t>(hash >> 48);
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+        const Slot& slot = slots[index];
+        if (slot.length == 0)
+            return 0;
+        if (slot.tag == tag && slot.length == term.size() &&
+            std::memcmp(keys.data() + slot.keyOffset, term.data(), term.size()) == 0)
+            return weights[index];
+    }
+}
+
+// ------------------- TieredWeights Class -------------------
+// Hot tier in front of a scoring table. Token frequencies are Zipfian, so a
+// few thousand terms cover most lookups. The hot tier keeps the most
+// frequent terms in a small linear-probing table with the term bytes inline
+// (one 32-byte slot per term, at most half full), so a probe never leaves
+// the table and the whole tier stays in L1/L2. The cold tier is the scoring
+// table itself (TermTable or QuantizedModel), passed to every lookup, so the
+// split adds only the hot slots to memory. A lookup hashes the term once
+// with the cold table's hash and probes the hot tier first, so a hot miss
+// costs two probes. The split only pays off when the single table no longer
+// fits in cache (around a million terms); below that it is slower.
+class TieredWeights {
+public:
+    static const size_t HOT_TERM_BYTES = 27; // Longer terms always go to the cold tier
+
+    // Stage every term with its weight, then build() picks the hot ones;
+    // staged terms must stay valid until build() returns
+    void add(std::string_view term, int32_t weight, uint32_t occurrences);
+    // Terms are ranked by training occurrences; models that do not record
+    // occurrences fall back to ranking by weight magnitude
+    template <typename Cold>
+    void build(size_t hotTerms, const Cold& cold);
+
+    // The hot tier's weight of term if it is hot; hash is cold.hash(term)
+    bool findHot(std::string_view term, uint64_t hash, int32_t& weight) const;
+    template <typename Cold>
+    int32_t weightOf(std::string_view term, const Cold& cold) const {
+        uint64_t hash = cold.hash(term);
+        int32_t weight;
+        return findHot(term, hash, weight) ? weight : cold.weightOf(term, hash);
+    }
+
+    size_t size() const { return termCount; }
+    size_t hotSize() const { return hotCount; }
+    size_t hotBytes() const { return hotSlots.size() * sizeof(HotSlot); }
+    bool rankedByOccurrences() const { return byOccurrences; }
+
+private:
+    struct HotSlot {
+        uint8_t length = 0; // 0 marks an empty slot
+        char term[HOT_TERM_BYTES];
+        int32_t weight = 0;
+    };
+
+    std::vector<HotSlot> hotSlots;
+    size_t hotMask = 0;
+    size_t hotCount = 0;
+    size_t termCount = 0;
+
+    struct Staged {
+        std::string_view term;
+        int32_t weight;
+        uint32_t occurrences;
+    };
+    std::vector<Staged> staged;
+    bool byOccurrences = false;
+};
+
+void TieredWeights::add(std::string_view term, int32_t weight, uint32_t occurrences) {
+    staged.push_back({ term, weight, occurrences });
+}
+
+template <typename Cold>
+void TieredWeights::build(size_t hotTerms, const Cold& cold) {
+    byOccurrences = false;
+    for (const auto& entry : staged)
+        byOccurrences = byOccurrences || entry.occurrences > 0;
+    std::sort(staged.begin(), staged.end(), [this](const Staged& a, const Staged& b) {
+        uint64_t rankA = byOccurrences ? a.occurrences : static_cast<uint64_t>(std::llabs(a.weight));
+        uint64_t rankB = byOccurrences ? b.occurrences : static_cast<uint64_t>(std::llabs(b.weight));
+        if (rankA != rankB)
+            return rankA > rankB;
+        return termLess(a.term.data(), a.term.size(), b.term.data(), b.term.size());
+    });
+
+    size_t slots = 16;
+    while (slots < 2 * hotTerms)
+        slots *= 2;
+    hotSlots.assign(hotTerms ? slots : 0, HotSlot());
+    hotMask = slots - 1;
+    hotCount = 0;
+    termCount = staged.size();
+
+    for (const auto& entry : staged) {
+        if (hotCount == hotTerms)
+            break;
+        if (entry.term.size() > HOT_TERM_BYTES)
+            continue;
+        size_t index = cold.hash(entry.term) & hotMask;
+        while (hotSlots[index].length != 0)
+            index = (index + 1) & hotMask;
+        hotSlots[index].length = static_cast<uint8_t>(entry.term.size());
+        std::memcpy(hotSlots[index].term, entry.term.data(), entry.term.size());
+        hotSlots[index].weight = entry.weight;
+        hotCount++;
+    }
+    staged.clear();
+    staged.shrink_to_fit();
+}
+
+bool TieredWeights::findHot(std::string_view term, uint64_t hash, int32_t& weight) const {
+    if (hotSlots.empty() || term.size() > HOT_TERM_BYTES)
+        return false;
+    for (size_t index = hash & hotMask;; index = (index + 1) & hotMask) {
+        const HotSlot& slot = hotSlots[index];
+        if (slot.length == 0)
+            return false;
+        if (slot.length == term.size() && std::memcmp(slot.term, term.data(), term.size()) == 0) {
+            weight = slot.weight;
+            return true;
+        }
+    }
+}
+
+#endif // SENTIMENT_LIBRARY
+
+// Set of stop words to ignore during tokenization
+using StopWordSet = DSHashMap<DSString, bool, DSStringHash, DSStringEqual>;
+
+// Load a predefined set of stop words
+void loadDefaultStopWords(StopWordSet& stopWords) {
+    // A minimal set of English stop words. For a comprehensive list, consider expanding this.
+    std::vector<std::string> stopWordsList = {
+        "a", "an", "and", "are", "as", "at", "be", "but", "by",
+        "for", "if", "in", "into", "is", "it",
+        "no", "not", "of", "on", "or", "such",
+        "that", "the", "their", "then", "there", "these",
+        "they", "this", "to", "was", "will", "with",
+        "have", "has", "had", "do", "does", "did",
+        "from", "up", "down", "out", "about", "above", "below",
+        "under", "again", "further", "once", "here",
+        "there", "when", "where", "why", "how", "all", "any",
+        "both", "each", "few", "more", "most", "other", "some",
+        "only", "own", "same", "so", "than", "too",
+        "very", "can", "will", "just", "don't", "should", "now"
+    };
+
+    for (const auto& word : stopWordsList) {
+        DSString dsWord(word.c_str());
+        stopWords.try_emplace(dsWord, true);
+    }
+}
+
+// ----------------------- Term Scanner -----------------------
+// Allocation-free tokenizer: optionally lowercases, always strips
+// punctuation, optionally stems each whitespace-separated word in a stack
+// buffer and passes the surviving terms to callback as string_views. With
+// the default pipeline this is exactly the original SentimentClassifier
+// tokenizer. Words longer than MAX_TERM_LENGTH bytes are skipped.
+static const size_t MAX_TERM_LENGTH = 1024;
+
+template <typename Policy = DefaultPipeline, typename Callback>
+void forEachTerm(std::string_view tweet, const StopWordSet& stopWords, Callback&& callback) {
+    char term[MAX_TERM_LENGTH];
+    // Bigram state: the previous surviving term, then a space, then the current one
+    char bigram[2 * MAX_TERM_LENGTH + 1];
+    size_t previousLength = 0;
+
+    size_t pos = 0;
+    while (pos < tweet.size()) {
+        while (pos < tweet.size() && std::isspace(static_cast<unsigned char>(tweet[pos])))
+            pos++;
+        size_t start = pos;
+        while (pos < tweet.size() && !std::isspace(static_cast<unsigned char>(tweet[pos])))
+            pos++;
+        if (pos - start > MAX_TERM_LENGTH)
+            continue;
+
+        // Lowercase and drop punctuation
+        size_t length = 0;
+        for (size_t i = start; i < pos; ++i) {
+            unsigned char c = static_cast<unsigned char>(tweet[i]);
+            if constexpr (Policy::lowercase)
+                c = static_cast<unsigned char>(std::tolower(c));
+            if (!std::ispunct(c))
+                term[length++] = static_cast<char>(c);
+        }
+        if (length == 0)
+            continue;
+
+        // Strip one common suffix
+        if constexpr (Policy::stem) {
+            if (length > 4 && std::memcmp(term + length - 3, "ing", 3) == 0)
+                length -= 3;
+            else if (length > 3 && std::memcmp(term + length - 2, "ed", 2) == 0)
+                length -= 2;
+            else if (length > 1 && term[length - 1] == 's')
+                length -= 1;
+        }
+
+        std::string_view word(term, length);
+        if constexpr (Policy::stopWords) {
+            if (stopWords.contains(word))
+                continue;
+        }
+        callback(word);
+
+        if constexpr (Policy::bigrams) {
+            if (previousLength > 0) {
+                bigram[previousLength] = ' ';
+                std::memcpy(bigram + previousLength + 1, term, length);
+                callback(std::string_view(bigram, previousLength + 1 + length));
+            }
+            std::memcpy(bigram, term, length);
+            previousLength = length;
+        }
+    }
+}
+
+#ifndef SENTIMENT_LIBRARY
+// ------------------- BatchScorer Class -------------------
+// Scores a block of tweets at once. All tokens of the block are tokenized
+// into one buffer and hashed first; the weights are then looked up directly
+// in the scoring table with the probe of the token PREFETCH_DISTANCE ahead
+// prefetched while the current one is compared, and summed per row. The
+// table is any of TermTable, QuantizedModel<int8_t> or QuantizedModel<int16_t>:
+// it provides hash(term), prefetch(hash) and weightOf(term, hash).
+// Measured, this is not faster than per-tweet scoring: even a 1.2M-term
+// table is probed for few enough distinct hot terms that the per-tweet
+// probes already hit cache, and buffering the block costs more than the
+// prefetches save.
+class BatchScorer {
+public:
+    void setBias(int32_t value) { bias = value; }
+
+    template <typename Policy>
+    void addTweet(std::string_view tweet, const StopWordSet& stopWords);
+    size_t rows() const { return rowTermEnds.size(); }
+
+    // Score every added row with the weights in table, then start a new block
+    template <typename Table>
+    void score(const Table& table, std::vector<int32_t>& scores);
+
+private:
+    static const size_t PREFETCH_DISTANCE = 8;
+
+    int32_t bias = 0;
+
+    // Block being filled: term bytes and where each term and row ends
+    std::string termBytes;
+    std::vector<uint32_t> termEnds;
+    std::vector<uint32_t> rowTermEnds;
+
+    std::vector<uint64_t> hashes; // Reused scratch for the scoring pass
+};
+
+template <typename Policy>
+void BatchScorer::addTweet(std::string_view tweet, const StopWordSet& stopWords) {
+    forEachTerm<Policy>(tweet, stopWords, [this](std::string_view term) {
+        termBytes.append(term.data(), term.size());
+        termEnds.push_back(static_cast<uint32_t>(termBytes.size()));
+    });
+    rowTermEnds.push_back(static_cast<uint32_t>(termEnds.size()));
+}
+
+template <typename Table>
+void BatchScorer::score(const Table& table, std::vector<int32_t>& scores) {
+    size_t termCount = termEnds.size();
+    auto termAt = [this](size_t i) {
+        uint32_t start = (i == 0) ? 0 : termEnds[i - 1];
+        return std::string_view(termBytes.data() + start, termEnds[i] - start);
+    };
+
+    // Hash every token so the probes can be prefetched ahead of the lookups
+    hashes.resize(termCount);
+    for (size_t i = 0; i < termCount; ++i)
+        hashes[i] = table.hash(termAt(i));
+
+    scores.assign(rowTermEnds.size(), 0);
+    size_t term = 0;
+    for (size_t row = 0; row < rowTermEnds.size(); ++row) {
+        int32_t sum = bias;
+        for (; term < rowTermEnds[row]; ++term) {
+            if (term + PREFETCH_DISTANCE < termCount)
+                table.prefetch(hashes[term + PREFETCH_DISTANCE]);
+            sum += table.weightOf(termAt(term), hashes[term]);
+        }
+        scores[row] = sum;
+    }
+
+    termBytes.clear();
+    termEnds.clear();
+    rowTermEnds.clear();
+}
+
+// ------------------- LogisticTrainer Class -------------------
+// Logistic regression over bag-of-words term counts, trained with lock-free
+// parallel SGD in the style of Hogwild: every thread reads and updates the
+// shared float weights with relaxed atomic loads and stores and no locks,
+// accepting that concurrent updates to the same term occasionally overwrite
+// each other. The bias is touched by every example, so each thread keeps its
+// own running bias and folds its updates into the shared one only every
+// BIAS_SYNC_EXAMPLES examples.
+// Examples are queued and tokenized LOGISTIC_BLOCK_EXAMPLES at a time, each
+// thread taking a contiguous slice of the block. Threads only read the
+// shared vocabulary and collect the terms it lacks in their own list; the
+// lists are merged in file order, so term IDs (and hence the model) are the
+// same as with one thread.
+static const size_t BIAS_SYNC_EXAMPLES = 64;
+static const size_t LOGISTIC_BLOCK_EXAMPLES = 1 << 16;
+
+struct LogisticOptions {
+    int epochs = 5;
+    float learningRate = 0.1f;
+    unsigned threads = 0; // 0 uses std::thread::hardware_concurrency()
+};
+
+class LogisticTrainer {
+public:
+    // Threads used for tokenization and SGD
+    static unsigned workerCount(const LogisticOptions& options) {
+        return options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Queue one labeled tweet; labels other than 0/4 are ignored
+    void addExample(int sentiment, std::string_view tweet);
+    size_t pendingExamples() const { return pendingLabels.size(); }
+    // Tokenize the queued tweets into the example matrix on workers threads
+    template <typename Policy>
+    void tokenizePending(const StopWordSet& stopWords, unsigned workers);
+    void train(const LogisticOptions& options);
+    void save(const std::string& modelFile, uint32_t pipeline, bool withOccurrences) const;
+
+    size_t examples() const { return labels.size(); }
+    size_t vocabularySize() const { return terms.size(); }
+    float bias() const { return biasWeight.load(std::memory_order_relaxed); }
+
+    // Calls callback(term, weight, occurrences) for every term after training
+    template <typename Callback>
+    void forEachWeight(Callback&& callback) const {
+        for (size_t id = 0; id < terms.size(); ++id)
+            callback(terms[id], weights[id].load(std::memory_order_relaxed), occurrences[id]);
+    }
+
+private:
+    VocabularyIndex vocabulary;
+    std::vector<DSString> terms; // Indexed by term ID
+    std::vector<uint32_t> occurrences; // Training tokens per term ID
+
+    // Examples as CSR rows of term IDs, one label (1 = positive) per row
+    std::vector<uint64_t> rowOffsets{ 0 };
+    std::vector<uint32_t> termIds;
+    std::vector<uint8_t> labels;
+
+    // Queued tweets: text, where each ends, and labels
+    std::string pendingText;
+    std::vector<size_t> pendingEnds;
+    std::vector<uint8_t> pendingLabels;
+
+    // One thread's slice of a block. Terms missing from the vocabulary get
+    // NEW_TERM | index into newTerms in place of a vocabulary ID.
+    static const uint32_t NEW_TERM = 1u << 31;
+    struct TokenShard {
+        std::vector<uint32_t> termIds;
+        std::vector<size_t> rowEnds;
+        VocabularyIndex newIds;
+        std::vector<DSString> newTerms;
+    };
+
+    std::unique_ptr<std::atomic<float>[]> weights;
+    alignas(64) std::atomic<float> biasWeight{ 0.0f }; // Last member, alone on its cache line
+
+    void runWorker(unsigned worker, unsigned workers, const LogisticOptions& options);
+    float foldBias(float delta); // Add delta to the shared bias; returns the new bias
+};
+
+void LogisticTrainer::addExample(int sentiment, std::string_view tweet) {
+    if (sentiment != 0 && sentiment != 4)
+        return;
+    pendingText.append(tweet.data(), tweet.size());
+    pendingEnds.push_back(pendingText.size());
+    pendingLabels.push_back(sentiment == 4 ? 1 : 0);
+}
+
+template <typename Policy>
+void LogisticTrainer::tokenizePending(const StopWordSet& stopWords, unsigned workers) {
+    size_t rows = pendingLabels.size();
+    if (rows == 0)
+        return;
+    workers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(workers, rows)));
+
+    std::vector<TokenShard> shards(workers);
+    auto tokenizeShard = [&](unsigned shard) {
+        TokenShard& out = shards[shard];
+        for (size_t row = rows * shard / workers; row < rows * (shard + 1) / workers; ++row) {
+            size_t start = (row == 0) ? 0 : pendingEnds[row - 1];
+            std::string_view tweet(pendingText.data() + start, pendingEnds[row] - start);
+            forEachTerm<Policy>(tweet, stopWords, [this, &out](std::string_view term) {
+                uint32_t id = vocabulary.lookup(term); // Read-only while the shards run
+                if (id == VocabularyIndex::npos) {
+                    id = out.newIds.lookup(term);
+                    if (id == VocabularyIndex::npos) {
+                        out.newTerms.emplace_back(term.data(), term.size());
+                        id = out.newIds.add(out.newTerms.back());
+                    }
+                    id |= NEW_TERM;
+                }
+                out.termIds.push_back(id);
+            });
+            out.rowEnds.push_back(out.termIds.size());
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned shard = 1; shard < workers; ++shard)
+        threads.emplace_back(tokenizeShard, shard);
+    tokenizeShard(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    // In file order, each shard's new terms in order of first use get the
+    // next IDs, exactly as tokenizing the tweets one by one would assign them
+    std::vector<uint32_t> shardIds;
+    for (TokenShard& shard : shards) {
+        shardIds.resize(shard.newTerms.size());
+        for (size_t i = 0; i < shard.newTerms.size(); ++i) {
+            uint32_t id = vocabulary.lookup(shard.newTerms[i]);
+            if (id == VocabularyIndex::npos) {
+                terms.push_back(std::move(shard.newTerms[i]));
+                occurrences.push_back(0);
+                id = vocabulary.add(terms.back());
+            }
+            shardIds[i] = id;
+        }
+        size_t token = 0;
+        for (size_t rowEnd : shard.rowEnds) {
+            for (; token < rowEnd; ++token) {
+                uint32_t id = shard.termIds[token];
+                if (id & NEW_TERM)
+                    id = shardIds[id & ~NEW_TERM];
+                occurrences[id]++;
+                termIds.push_back(id);
+            }
+            rowOffsets.push_back(termIds.size());
+        }
+    }
+    labels.insert(labels.end(), pendingLabels.begin(), pendingLabels.end());
+    pendingText.clear();
+    pendingEnds.clear();
+    pendingLabels.clear();
+}
+
+void LogisticTrainer::train(const LogisticOptions& options) {
+    weights.reset(new std::atomic<float>[terms.size()]);
+    for (size_t id = 0; id < terms.size(); ++id)
+        weights[id].store(0.0f, std::memory_order_relaxed);
+    biasWeight.store(0.0f, std::memory_order_relaxed);
+
+    unsigned workers = workerCount(options);
+    std::vector<std::thread> threads;
+    for (unsigned worker = 1; worker < workers; ++worker)
+        threads.emplace_back(&LogisticTrainer::runWorker, this, worker, workers, std::cref(options));
+    runWorker(0, workers, options);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// SGD over every workers-th example, reshuffled each epoch
+void LogisticTrainer::runWorker(unsigned worker, unsigned workers, const LogisticOptions& options) {
+    std::vector<size_t> order;
+    for (size_t row = worker; row < labels.size(); row += workers)
+        order.push_back(row);
+
+    std::mt19937 random(worker + 1);
+    float localBias = biasWeight.load(std::memory_order_relaxed);
+    float pendingBias = 0.0f; // Updates not yet folded into biasWeight
+    size_t sinceFold = 0;
+    for (int epoch = 0; epoch < options.epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), random);
+        float rate = options.learningRate / (1.0f + epoch);
+        for (size_t row : order) {
+            const uint32_t* ids = termIds.data() + rowOffsets[row];
+            size_t count = rowOffsets[row + 1] - rowOffsets[row];
+
+            float z = localBias;
+            for (size_t i = 0; i < count; ++i)
+                z += weights[ids[i]].load(std::memory_order_relaxed);
+            z = std::max(-30.0f, std::min(30.0f, z));
+            float predicted = 1.0f / (1.0f + std::exp(-z));
+            float step = rate * (static_cast<float>(labels[row]) - predicted);
+
+            for (size_t i = 0; i < count; ++i) {
+                std::atomic<float>& weight = weights[ids[i]];
+                weight.store(weight.load(std::memory_order_relaxed) + step, std::memory_order_relaxed);
+            }
+            localBias += step;
+            pendingBias += step;
+            if (++sinceFold == BIAS_SYNC_EXAMPLES) {
+                localBias = foldBias(pendingBias);
+                pendingBias = 0.0f;
+                sinceFold = 0;
+            }
+        }
+    }
+    foldBias(pendingBias);
+}
+
+float LogisticTrainer::foldBias(float delta) {
+    float current = biasWeight.load(std::memory_order_relaxed);
+    while (!biasWeight.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+    }
+    return current + delta;
+}
+
+void LogisticTrainer::save(const std::string& modelFile, uint32_t pipeline, bool withOccurrences) const {
+    std::vector<uint32_t> sorted(terms.size());
+    for (uint32_t id = 0; id < sorted.size(); ++id)
+        sorted[id] = id;
+    std::sort(sorted.begin(), sorted.end(), [this](uint32_t a, uint32_t b) {
+        return termLess(terms[a].c_str(), terms[a].length(), terms[b].c_str(), terms[b].length());
+    });
+
+    ModelWriter writer;
+    if (!writer.openLogistic(modelFile, bias(), pipeline, withOccurrences)) {
+        std::cerr << "Error opening model file: " << modelFile << std::endl;
+        exit(1);
+    }
+    for (uint32_t id : sorted)
+        writer.writeWeight(terms[id].c_str(), static_cast<uint32_t>(terms[id].length()), weights[id].load(std::memory_order_relaxed), occurrences[id]);
+    writer.close();
+    std::cout << "Model saved to " << modelFile << " (" << writer.entries() << " terms, logistic regression)" << std::endl;
+}
+
+// ------------------- SentimentAggregator Class -------------------
+// Days since 1970-01-01 for a proleptic Gregorian date, and back
+// (H. Hinnant's civil calendar algorithms)
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= (month <= 2);
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned shiftedMonth = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    month = (shiftedMonth < 10) ? shiftedMonth + 3 : shiftedMonth - 9;
+    year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2);
+}
+
+// All of text as a decimal number of exactly digits digits
+static bool parseFixedDigits(std::string_view text, size_t digits, int& value) {
+    if (text.size() != digits)
+        return false;
+    value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9')
+            return false;
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+// Parse a tweet timestamp such as "Tue Jun 02 05:08:46 PDT 2009" into Unix
+// seconds (UTC) by hand, without strptime or the locale. The weekday is
+// not checked; the zone must be UTC/GMT or a US zone abbreviation.
+bool parseTweetDate(std::string_view text, int64_t& seconds) {
+    std::string_view fields[6]; // weekday, month, day, hh:mm:ss, zone, year
+    size_t count = 0;
+    size_t pos = 0;
+    while (count < 6) {
+        while (pos < text.size() && text[pos] == ' ')
+            pos++;
+        size_t start = pos;
+        while (pos < text.size() && text[pos] != ' ')
+            pos++;
+        if (pos == start)
+            return false;
+        fields[count++] = text.substr(start, pos - start);
+    }
+
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    unsigned month = 0;
+    for (unsigned i = 0; i < 12 && fields[1].size() == 3; ++i) {
+        if (std::memcmp(fields[1].data(), MONTHS + 3 * i, 3) == 0)
+            month = i + 1;
+    }
+
+    static const struct { char name[4]; int hours; } ZONES[] = {
+        { "UTC", 0 }, { "GMT", 0 }, { "EDT", -4 }, { "EST", -5 }, { "CDT", -5 },
+        { "CST", -6 }, { "MDT", -6 }, { "MST", -7 }, { "PDT", -7 }, { "PST", -8 }
+    };
+    int zoneHours = 1; // Sentinel: unknown zone
+    for (const auto& zone : ZONES) {
+        if (fields[4].size() == 3 && std::memcmp(fields[4].data(), zone.name, 3) == 0)
+            zoneHours = zone.hours;
+    }
+
+    std::string_view clock = fields[3];
+    int day, year, hour, minute, second;
+    if (month == 0 || zoneHours == 1 ||
+        !(parseFixedDigits(fields[2], 2, day) || parseFixedDigits(fields[2], 1, day)) ||
+        !parseFixedDigits(fields[5], 4, year) ||
+        clock.size() != 8 || clock[2] != ':' || clock[5] != ':' ||
+        !parseFixedDigits(clock.substr(0, 2), 2, hour) ||
+        !parseFixedDigits(clock.substr(3, 2), 2, minute) ||
+        !parseFixedDigits(clock.substr(6, 2), 2, second))
+        return false;
+    if (day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+        return false;
+
+    seconds = daysFromCivil(year, month, static_cast<unsigned>(day)) * 86400 +
+              hour * 3600 + minute * 60 + second - zoneHours * 3600;
+    return true;
+}
+
+// "2009-06-02T12:00:00Z"
+std::string formatUtc(int64_t seconds) {
+    int64_t days = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    int64_t secondOfDay = seconds - days * 86400;
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    char text[64];
+    std::snprintf(text, sizeof(text), "%04lld-%02u-%02uT%02d:%02d:%02dZ", static_cast<long long>(year), month, day,
+                  static_cast<int>(secondOfDay / 3600), static_cast<int>(secondOfDay / 60 % 60), static_cast<int>(secondOfDay % 60));
+    return text;
+}
+
+// Prediction counts and score sum of a group of tweets
+struct SentimentTally {
+    uint64_t positive = 0;
+    uint64_t negative = 0;
+    int64_t scoreSum = 0;
+
+    void add(int score) {
+        if (score >= 0)
+            positive++;
+        else
+            negative++;
+        scoreSum += score;
+    }
+    uint64_t tweets() const { return positive + negative; }
+};
+
+// Space-Saving top-K: at most capacity users are tracked. An untracked user
+// replaces the one with the smallest count and inherits that count (plus
+// one) as an overestimate, so every user with more than N / capacity tweets
+// is guaranteed to be in the table. Its tally only covers tweets since it
+// entered the table.
+class HeavyHitters {
+public:
+    explicit HeavyHitters(size_t capacity) : capacity(capacity) { index.reserve(capacity); }
+
+    void add(std::string_view user, int score);
+
+    struct Counter {
+        DSString user;
+        uint64_t count = 0; // Upper bound on the user's tweets
+        uint64_t error = 0; // How much count may overestimate
+        SentimentTally tally;
+    };
+    // Tracked users, largest count first
+    std::vector<const Counter*> ranked() const;
+    size_t size() const { return counters.size(); }
+
+private:
+    size_t capacity;
+    std::vector<Counter> counters;
+    std::vector<uint32_t> heap; // Min-heap of counter indices by count
+    std::vector<uint32_t> heapPosition; // Where each counter sits in heap
+    DSHashMap<DSString, uint32_t, DSStringHash, DSStringEqual> index;
+
+    void siftDown(size_t position);
+    void siftUp(size_t position);
+};
+
+void HeavyHitters::add(std::string_view user, int score) {
+    auto found = index.find(user);
+    if (found != index.end()) {
+        uint32_t id = found->second;
+        counters[id].count++;
+        counters[id].tally.add(score);
+        siftDown(heapPosition[id]); // Counts only grow
+        return;
+    }
+    if (capacity == 0)
+        return;
+
+    uint32_t id;
+    if (counters.size() < capacity) {
+        id = static_cast<uint32_t>(counters.size());
+        counters.emplace_back();
+        heap.push_back(id);
+        heapPosition.push_back(static_cast<uint32_t>(heap.size() - 1));
+        counters[id].user = DSString(user.data(), user.size());
+        counters[id].count = 1;
+        counters[id].tally.add(score);
+        index.try_emplace(counters[id].user, id);
+        siftUp(heapPosition[id]);
+        return;
+    }
+
+    // Evict the minimum
+    id = heap[0];
+    Counter& counter = counters[id];
+    index.erase(counter.user);
+    counter.user = DSString(user.data(), user.size());
+    counter.error = counter.count;
+    counter.count++;
+    counter.tally = SentimentTally();
+    counter.tally.add(score);
+    index.try_emplace(counter.user, id);
+    siftDown(0);
+}
+
+void HeavyHitters::siftDown(size_t position) {
+    for (;;) {
+        size_t smallest = position;
+        for (size_t child = 2 * position + 1; child <= 2 * position + 2 && child < heap.size(); ++child) {
+            if (counters[heap[child]].count < counters[heap[smallest]].count)
+                smallest = child;
+        }
+        if (smallest == position)
+            return;
+        std::swap(heap[position], heap[smallest]);
+        heapPosition[heap[position]] = static_cast<uint32_t>(position);
+        heapPosition[heap[smallest]] = static_cast<uint32_t>(smallest);
+        position = smallest;
+    }
+}
+
+void HeavyHitters::siftUp(size_t position) {
+    while (position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (counters[heap[parent]].count <= counters[heap[position]].count)
+            return;
+        std::swap(heap[position], heap[parent]);
+        heapPosition[heap[position]] = static_cast<uint32_t>(position);
+        heapPosition[heap[parent]] = static_cast<uint32_t>(parent);
+        position = parent;
+    }
+}
+
+std::vector<const HeavyHitters::Counter*> HeavyHitters::ranked() const {
+    std::vector<const Counter*> ranking;
+    for (const auto& counter : counters)
+        ranking.push_back(&counter);
+    std::sort(ranking.begin(), ranking.end(), [](const Counter* a, const Counter* b) {
+        if (a->count != b->count)
+            return a->count > b->count;
+        return termLess(a->user.c_str(), a->user.length(), b->user.c_str(), b->user.length());
+    });
+    return ranking;
+}
+
+// Rolls predictions up by fixed time window and by user, in memory bounded
+// by the number of windows and the top-K user capacity
+class SentimentAggregator {
+public:
+    SentimentAggregator(int64_t windowSeconds, size_t topUsers) : window(windowSeconds), users(topUsers) {}
+
+    void add(std::string_view date, std::string_view user, int score);
+
+    // <prefix>.windows.csv and <prefix>.users.csv
+    void write(const std::string& prefix, IoBackend backend) const;
+
+private:
+    int64_t window;
+    std::map<int64_t, SentimentTally> windows; // Keyed by window start (Unix seconds)
+    int64_t lastWindow = 0;
+    SentimentTally* lastTally = nullptr; // Tweets mostly arrive in time order
+    SentimentTally undated;
+    HeavyHitters users;
+};
+
+void SentimentAggregator::add(std::string_view date, std::string_view user, int score) {
+    int64_t seconds;
+    if (!parseTweetDate(date, seconds)) {
+        undated.add(score);
+    }
+    else {
+        int64_t start = (seconds >= 0 ? seconds : seconds - window + 1) / window * window;
+        if (!lastTally || start != lastWindow) {
+            lastTally = &windows[start];
+            lastWindow = start;
+        }
+        lastTally->add(score);
+    }
+    users.add(user, score);
+}
+
+void SentimentAggregator::write(const std::string& prefix, IoBackend backend) const {
+    auto openOrExit = [backend](LineWriter& out, const std::string& path) {
+        if (!out.open(path, backend)) {
+            std::cerr << "Error opening output file: " << path << std::endl;
+            exit(1);
+        }
+    };
+    // ",positive,negative,positive_share,mean_score\n"
+    auto tallyColumns = [](const SentimentTally& tally) {
+        char text[128];
+        double tweets = static_cast<double>(tally.tweets());
+        int length = std::snprintf(text, sizeof(text), ",%llu,%llu,%.4f,%.3f\n",
+                                   static_cast<unsigned long long>(tally.positive),
+                                   static_cast<unsigned long long>(tally.negative),
+                                   tweets > 0 ? tally.positive / tweets : 0.0,
+                                   tweets > 0 ? tally.scoreSum / tweets : 0.0);
+        return std::string(text, static_cast<size_t>(length));
+    };
+
+    LineWriter out;
+    openOrExit(out, prefix + ".windows.csv");
+    out.write("window_start,tweets,positive,negative,positive_share,mean_score\n");
+    auto writeWindow = [&](const std::string& label, const SentimentTally& tally) {
+        out.write(label);
+        out.write("," + std::to_string(tally.tweets()));
+        out.write(tallyColumns(tally));
+    };
+    for (const auto& entry : windows)
+        writeWindow(formatUtc(entry.first), entry.second);
+    if (undated.tweets() > 0)
+        writeWindow("undated", undated);
+    out.close();
+
+    openOrExit(out, prefix + ".users.csv");
+    out.write("user,tweets,overcount,positive,negative,positive_share,mean_score\n");
+    for (const auto* counter : users.ranked()) {
+        out.write(std::string_view(counter->user.c_str(), counter->user.length()));
+        out.write("," + std::to_string(counter->count) + "," + std::to_string(counter->error));
+        out.write(tallyColumns(counter->tally)); // Tweets since the user entered the table
+    }
+    out.close();
+
+    std::cout << "Aggregation completed. " << windows.size() << " windows";
+    if (undated.tweets() > 0)
+        std::cout << " (" << undated.tweets() << " tweets without a parseable date)";
+    std::cout << ", top " << users.size() << " users written to " << prefix << ".windows.csv and "
+              << prefix << ".users.csv" << std::endl;
+}
+
+// ------------------- ModelEnsemble Class -------------------
+// Several models scored in one pass over the test set. Their vocabularies
+// are merged into one index whose rows hold every model's weight for the
+// term, so a tweet is tokenized once and each term costs one lookup plus
+// a row of N adds. The models must agree on case, stemming and bigrams.
+// Unigram models may differ in stop-word handling: the tweet is then
+// tokenized with stop words kept. A model that drops stop words never saw
+// one in training, so stop words are missing from its file and their
+// columns stay 0, which is that model's own score exactly.
+enum class EnsembleVote {
+    Columns,  // One prediction column per model
+    Majority, // One vote per model
+    Weighted  // Votes scaled by per-model weights
+};
+
+bool parseEnsembleVote(const std::string& name, EnsembleVote& vote) {
+    if (name == "columns")
+        vote = EnsembleVote::Columns;
+    else if (name == "majority")
+        vote = EnsembleVote::Majority;
+    else if (name == "weighted")
+        vote = EnsembleVote::Weighted;
+    else
+        return false;
+    return true;
+}
+
+// Comma-separated numbers, e.g. "1,0.5,2"
+bool parseNumberList(const std::string& list, std::vector<double>& numbers) {
+    numbers.clear();
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos)
+            comma = list.size();
+        std::string field = list.substr(start, comma - start);
+        try {
+            size_t used = 0;
+            numbers.push_back(std::stod(field, &used));
+            if (used != field.size() || !std::isfinite(numbers.back()))
+                return false;
+        }
+        catch (...) {
+            return false;
+        }
+        start = comma + 1;
+    }
+    return true;
+}
+
+class ModelEnsemble {
+public:
+    void load(const std::vector<std::string>& modelFiles);
+    // Comma-separated vote weights, one per model (default 1 each)
+    bool setVoteWeights(const std::string& list);
+    // Comma-separated score thresholds, one per model (default 0): a model
+    // predicts positive when its score is at least its threshold. Count
+    // models use count units, logistic models the logit.
+    bool setThresholds(const std::string& list);
+
+    size_t models() const { return biases.size(); }
+    uint32_t pipeline() const { return sharedPipeline; }
+    size_t vocabularySize() const { return vocabulary.size(); }
+
+    // scores[model] starts at the model's bias and sums its term weights
+    void startScores(int32_t* scores) const {
+        for (size_t model = 0; model < biases.size(); ++model)
+            scores[model] = biases[model];
+    }
+    void addTerm(std::string_view term, int32_t* scores) const {
+        uint32_t id = vocabulary.lookup(term);
+        if (id == VocabularyIndex::npos)
+            return;
+        const int32_t* row = &weights[static_cast<size_t>(id) * biases.size()];
+        for (size_t model = 0; model < biases.size(); ++model)
+            scores[model] += row[model];
+    }
+
+    bool positive(const int32_t* scores, size_t model) const { return scores[model] >= thresholds[model]; }
+    // Positive when the (weighted) majority of models predicts positive;
+    // a tie counts as positive, like a zero score
+    int vote(const int32_t* scores) const;
+
+private:
+    VocabularyIndex vocabulary;
+    std::vector<int32_t> weights; // One row per term ID, one column per model
+    std::vector<int32_t> biases;
+    std::vector<double> voteWeights;
+    std::vector<double> thresholds; // In score units (fixed point for logistic models)
+    std::vector<bool> logisticModels;
+    uint32_t sharedPipeline = 0;
+};
+
+void ModelEnsemble::load(const std::vector<std::string>& modelFiles) {
+    size_t count = modelFiles.size();
+    biases.assign(count, 0);
+    voteWeights.assign(count, 1.0);
+    thresholds.assign(count, 0.0);
+    logisticModels.assign(count, false);
+    size_t dropStopWords = 0; // Models that drop stop words
+    uint32_t firstPipeline = 0;
+    for (size_t model = 0; model < count; ++model) {
+        ModelReader reader;
+        if (!reader.open(modelFiles[model])) {
+            std::cerr << "Error opening model file: " << modelFiles[model] << std::endl;
+            exit(1);
+        }
+        uint32_t flags = reader.pipeline();
+        if (model == 0) {
+            firstPipeline = flags;
+            vocabulary.reserve(reader.entries());
+            weights.reserve(reader.entries() * count);
+        }
+        else if ((flags & ~PIPELINE_NO_STOP_WORDS) != (firstPipeline & ~PIPELINE_NO_STOP_WORDS) ||
+                 (flags != firstPipeline && (flags & PIPELINE_BIGRAMS))) {
+            std::cerr << "Model " << modelFiles[model] << " was trained with pipeline \""
+                      << describePipeline(flags) << "\" but " << modelFiles[0] << " with \""
+                      << describePipeline(firstPipeline) << "\"; ensemble models must share case, stemming and"
+                      << " bigram options (stop-word handling may differ only without bigrams)" << std::endl;
+            exit(1);
+        }
+        sharedPipeline |= flags; // Keeps stop words if any model does
+        dropStopWords += !(flags & PIPELINE_NO_STOP_WORDS);
+
+        readModelEntries(reader, modelFiles[model], [&]() {
+            size_t id = vocabulary.add(DSString(reader.term().data(), reader.term().size()));
+            if ((id + 1) * count > weights.size())
+                weights.resize((id + 1) * count, 0);
+            weights[id * count + model] = reader.count();
+        });
+        biases[model] = reader.bias();
+        logisticModels[model] = reader.logistic();
+        std::cout << "Model " << model + 1 << ": " << modelFiles[model] << " (" << reader.entries() << " terms"
+                  << (reader.logistic() ? ", logistic regression" : "") << ")" << std::endl;
+    }
+    weights.resize(vocabulary.size() * count, 0); // Rows of terms only later models have
+
+    std::cout << "Ensemble of " << count << " models, " << vocabulary.size() << " distinct terms";
+    if (sharedPipeline != 0)
+        std::cout << ", pipeline: " << describePipeline(sharedPipeline);
+    if ((sharedPipeline & PIPELINE_NO_STOP_WORDS) && dropStopWords > 0)
+        std::cout << ", stop words filtered per model for " << dropStopWords << " of them";
+    std::cout << std::endl;
+}
+
+bool ModelEnsemble::setVoteWeights(const std::string& list) {
+    std::vector<double> parsed;
+    if (!parseNumberList(list, parsed) || parsed.size() != biases.size())
+        return false;
+    voteWeights = parsed;
+    return true;
+}
+
+bool ModelEnsemble::setThresholds(const std::string& list) {
+    std::vector<double> parsed;
+    if (!parseNumberList(list, parsed) || parsed.size() != biases.size())
+        return false;
+    for (size_t model = 0; model < parsed.size(); ++model)
+        thresholds[model] = logisticModels[model] ? parsed[model] * LOGISTIC_SCALE : parsed[model];
+    return true;
+}
+
+int ModelEnsemble::vote(const int32_t* scores) const {
+    double total = 0.0;
+    for (size_t model = 0; model < biases.size(); ++model)
+        total += positive(scores, model) ? voteWeights[model] : -voteWeights[model];
+    return (total >= 0.0) ? 1 : -1;
+}
+
+// ------------------- SentimentClassifier Class -------------------
+class SentimentClassifier {
+public:
+    // Training, Prediction, and Evaluation functions
+    void train(const std::string& trainingFile);
+    void predict(const std::string& testingFile, const std::string& resultsFile);
+    void evaluatePredictions(const std::string& groundTruthFile, const std::string& resultsFile, const std::string& accuracyFile);
+    // Score every test tweet into the aggregator's rollups instead of a results file
+    void aggregate(const std::string& testingFile, SentimentAggregator& aggregator);
+    // Score every test tweet against all models of the ensemble, tokenizing
+    // it once, and write one column per model or the ensemble vote
+    void predictEnsemble(const std::string& testingFile, const std::string& resultsFile,
+                         const ModelEnsemble& ensemble, EnsembleVote vote);
+
+    // Write the trained counts as a sorted model file / replace them with one
+    void saveModel(const std::string& modelFile);
+    void loadModel(const std::string& modelFile);
+
+    // Train logistic regression weights (see LogisticTrainer) in place of
+    // counts; they are kept as fixed-point word sentiments plus a bias.
+    // Also writes them to modelFile unless it is empty.
+    void trainLogistic(const std::string& trainingFile, const LogisticOptions& options, const std::string& modelFile);
+
+    // Train straight to a model file. With a nonzero memory budget (bytes of
+    // peak RSS), full tables are spilled as sorted runs next to modelFile and
+    // k-way merged at the end; the result is identical to in-memory training.
+    void trainToModel(const std::string& trainingFile, const std::string& modelFile, size_t memoryBudget);
+
+    // Switch prediction to an int8/int16 copy of the trained counts
+    void quantize(const std::string& weightType, QuantizationMode mode);
+    // Compare quantized and full-precision accuracy on the same tweets
+    void reportQuantization(const std::string& testingFile, const std::string& groundTruthFile);
+
+    // Reuse scores of previously seen tweet text; capacity 0 disables the cache
+    void enablePredictionCache(size_t capacity);
+    // Score tweets in blocks of this many rows with BatchScorer (no faster
+    // than one at a time, see BatchScorer); 0 scores one at a time
+    void setBatchSize(size_t rows) { batchSize = rows; }
+    // Score through TieredWeights with this many hot terms, built from the
+    // current (possibly quantized) weights; 0 uses the single table
+    void setHotTerms(size_t terms);
+    // Hits and misses of the prediction cache, if one is enabled; predict reports them itself
+    void reportPredictionCache() const;
+    // Hot-tier hit rate and per-token lookup latency, tiered vs single table
+    void reportTiers(const std::string& testingFile);
+    // Tokenization options (PipelineFlags) used for training; loadModel
+    // replaces them with the ones the model was trained with
+    void setPipeline(uint32_t flags) { pipeline = flags; }
+    // Also write per-term training occurrences into saved models (spill runs
+    // included), for TieredWeights to rank hot terms by
+    void setRecordOccurrences(bool record) { recordOccurrences = record; }
+    // How CSV inputs are read and results written (see LineReader)
+    void setIoBackend(IoBackend backend) { ioBackend = backend; }
+
+private:
+    TermTable wordSentiment; // Sentiment count (positive if > 0, negative if < 0) and occurrences per term
+    StopWordSet stopWords; // Set of stop words to ignore during tokenization
+    std::unique_ptr<QuantizedModel<int8_t>> quantized8; // Set when predicting with int8 weights
+    std::unique_ptr<QuantizedModel<int16_t>> quantized16; // Set when predicting with int16 weights
+    std::unique_ptr<PredictionCache> predictionCache; // Set when duplicate tweets should skip scoring
+    std::unique_ptr<TieredWeights> tiered; // Set when scoring through a hot/cold split
+    size_t batchSize = 0;
+    int32_t scoreBias = 0; // Added to every score; nonzero for logistic regression models
+    bool logisticWeights = false; // Weights are LOGISTIC_SCALE fixed point rather than counts
+    uint32_t pipeline = 0; // PipelineFlags; 0 is the original tokenizer
+    bool recordOccurrences = false;
+    IoBackend ioBackend = IoBackend::Stream;
+
+    // External-memory training state; tableBudget == 0 means unbounded
+    size_t tableBudget = 0; // Bytes wordSentiment and its key pool may use
+    std::string spillPrefix;
+    std::vector<std::string> spillRuns;
+
+    // Helper functions
+    // The per-tweet functions are instantiated once per Pipeline policy;
+    // train, predict and reportQuantization dispatch on pipeline once and
+    // run their whole loop inside the matching instantiation.
+    void loadStopWords(); // Load a predefined set of stop words
+    template <typename Policy>
+    void learnTweet(int sentiment, std::string_view tweet); // Add one labeled tweet to the counts
+    uint64_t writeSortedCounts(const std::string& modelFile);
+    bool overBudget() const;
+    void spillRun(); // Write wordSentiment as a sorted run and clear it
+    template <typename Policy>
+    int scoreTweet(std::string_view tweet); // Sum of word sentiments for a tweet
+    template <typename Policy>
+    int uncachedScore(std::string_view tweet);
+    template <typename Policy>
+    void predictBatched(const std::string& testingFile, LineWriter& results);
+    int32_t quantizedBias() const; // scoreBias in the units of the quantized weights
+    // Calls callback(table) with the table scores come from: the quantized model if any, else wordSentiment
+    template <typename Callback>
+    void withScoringTable(Callback&& callback) const;
+    void loadGroundTruth(const std::string& groundTruthFile, DSHashMap<long, int>& groundTruthMap);
+
+    // Calls callback(id, tweet) for every row of a CSV or columnar testing file
+    template <typename Callback>
+    void forEachTestTweet(const std::string& testingFile, Callback&& callback);
+    // Calls callback(sentiment, tweet) for every row of a CSV or columnar training file
+    template <typename Callback>
+    void forEachTrainingTweet(const std::string& trainingFile, Callback&& callback);
+    // Calls callback(date, user, tweet) for every row of a CSV or columnar testing file
+    template <typename Callback>
+    void forEachDatedTweet(const std::string& testingFile, Callback&& callback);
+};
+
+template <typename Callback>
+void SentimentClassifier::withScoringTable(Callback&& callback) const {
+    if (quantized8)
+        callback(*quantized8);
+    else if (quantized16)
+        callback(*quantized16);
+    else
+        callback(wordSentiment);
+}
+
+template <typename Callback>
+void SentimentClassifier::forEachTrainingTweet(const std::string& trainingFile, Callback&& callback) {
+    if (ColumnarDataset::isColumnar(trainingFile)) {
+        ColumnarDataset data;
+        if (!data.open(trainingFile) || !data.has(COL_LABEL | COL_TEXT)) {
+            std::cerr << "Invalid columnar training file: " << trainingFile << std::endl;
+            exit(1);
+        }
+        data.willNeed(COL_LABEL | COL_TEXT);
+        for (size_t row = 0; row < data.rows(); ++row) {
+            callback(data.label(row), data.text(row));
+        }
+        return;
+    }
+
+    LineReader file;
+    if (!file.open(trainingFile, ioBackend)) {
+        std::cerr << "Error opening training file: " << trainingFile << std::endl;
+        exit(1);
+    }
+
+    // Sentiment,id,Date,Query,User,Tweet; no header line based on assignment examples
+    std::string_view line;
+    std::string_view fields[6];
+    while (file.next(line)) {
+        if (!splitCsvFields(line, fields, 6))
+            continue;
+
+        int sentiment;
+        try {
+            sentiment = std::stoi(std::string(fields[0]));
+        }
+        catch (...) {
+            // Invalid sentiment value
+            continue;
+        }
+
+        callback(sentiment, fields[5].substr(0, fields[5].find('\0'))); // Stops at a NUL like the DSString copy did
+    }
+    file.close();
+}
+
+template <typename Callback>
+void SentimentClassifier::forEachTestTweet(const std::string& testingFile, Callback&& callback) {
+    if (ColumnarDataset::isColumnar(testingFile)) {
+        ColumnarDataset data;
+        if (!data.open(testingFile) || !data.has(COL_TEXT)) {
+            std::cerr << "Invalid columnar testing file: " << testingFile << std::endl;
+            exit(1);
+        }
+        data.willNeed(COL_ID | COL_TEXT);
+        for (size_t row = 0; row < data.rows(); ++row) {
+            callback(std::to_string(data.id(row)), data.text(row));
+        }
+        return;
+    }
+
+    LineReader file;
+    if (!file.open(testingFile, ioBackend)) {
+        std::cerr << "Error opening testing file: " << testingFile << std::endl;
+        exit(1);
+    }
+
+    // id,Date,Query,User,Tweet; no header line based on assignment examples
+    std::string_view line;
+    std::string_view fields[5];
+    std::string id;
+    while (file.next(line)) {
+        if (!splitCsvFields(line, fields, 5))
+            continue;
+        id.assign(fields[0].data(), fields[0].size());
+        callback(id, fields[4].substr(0, fields[4].find('\0')));
+    }
+    file.close();
+}
+
+template <typename Callback>
+void SentimentClassifier::forEachDatedTweet(const std::string& testingFile, Callback&& callback) {
+    if (ColumnarDataset::isColumnar(testingFile)) {
+        ColumnarDataset data;
+        if (!data.open(testingFile) || !data.has(COL_TEXT | COL_DATE | COL_USER)) {
+            std::cerr << "Columnar testing file needs date and user columns (convert without --no-meta): " << testingFile << std::endl;
+            exit(1);
+        }
+        data.willNeed(COL_TEXT | COL_DATE | COL_USER);
+        for (size_t row = 0; row < data.rows(); ++row)
+            callback(data.date(row), data.user(row), data.text(row));
+        return;
+    }
+
+    LineReader file;
+    if (!file.open(testingFile, ioBackend)) {
+        std::cerr << "Error opening testing file: " << testingFile << std::endl;
+        exit(1);
+    }
+
+    // id,Date,Query,User,Tweet
+    std::string_view line;
+    std::string_view fields[5];
+    while (file.next(line)) {
+        if (!splitCsvFields(line, fields, 5))
+            continue;
+        if (fields[0].empty() || !std::isdigit(static_cast<unsigned char>(fields[0][0])))
+            continue; // Header line
+        callback(fields[1], fields[3], fields[4].substr(0, fields[4].find('\0')));
+    }
+    file.close();
+}
+
+// Load a predefined set of stop words
+void SentimentClassifier::loadStopWords() {
+    loadDefaultStopWords(stopWords);
+}
+
+// Add one labeled tweet to the word counts
+template <typename Policy>
+void SentimentClassifier::learnTweet(int sentiment, std::string_view tweet) {
+    if (sentiment != 0 && sentiment != 4)
+        return; // Ignore sentiments not 0 or 4
+
+    int delta = (sentiment == 4) ? 1 : -1; // Positive / negative
+    forEachTerm<Policy>(tweet, stopWords, [this, delta](std::string_view word) {
+        TermStats* found = wordSentiment.find(word);
+        if (found) {
+            found->sentiment += delta;
+            found->occurrences++;
+            return;
+        }
+        if (tableBudget != 0 && overBudget())
+            spillRun();
+        wordSentiment[word] = TermStats{ delta, 1 };
+    });
+}
+
+// True when one more term could push the table, its key pool and the
+// pointer array used to sort a spill past the budget
+bool SentimentClassifier::overBudget() const {
+    if (wordSentiment.empty())
+        return false;
+    size_t slotBytes = wordSentiment.slotBytes();
+    if (wordSentiment.insertsBeforeGrowth() == 0)
+        slotBytes *= 3; // Old and doubled arrays coexist during a rehash
+    size_t keyBytes = wordSentiment.keyBytes();
+    if (wordSentiment.keyBytesBeforeGrowth() < 1024)
+        keyBytes *= 3; // Likewise when the pool grows
+    size_t sortBytes = (wordSentiment.size() + 1) * sizeof(void*);
+    return slotBytes + keyBytes + sortBytes > tableBudget;
+}
+
+void SentimentClassifier::spillRun() {
+    std::string runFile = spillPrefix + ".run" + std::to_string(spillRuns.size());
+    writeSortedCounts(runFile);
+    spillRuns.push_back(runFile);
+    wordSentiment.clear();
+}
+
+// Sum the learned sentiment of every known word in a tweet
+template <typename Policy>
+int SentimentClassifier::scoreTweet(std::string_view tweet) {
+    uint64_t textHash = 0;
+    if (predictionCache) {
+        int cachedScore;
+        textHash = hashText(tweet);
+        if (predictionCache->lookup(textHash, cachedScore))
+            return cachedScore;
+    }
+
+    int sentimentScore = uncachedScore<Policy>(tweet);
+    if (predictionCache)
+        predictionCache->insert(textHash, sentimentScore);
+    return sentimentScore;
+}
+
+template <typename Policy>
+int SentimentClassifier::uncachedScore(std::string_view tweet) {
+    if (tiered) {
+        int32_t total = quantizedBias();
+        withScoringTable([&](const auto& table) {
+            forEachTerm<Policy>(tweet, stopWords, [&](std::string_view word) {
+                total += tiered->weightOf(word, table);
+            });
+        });
+        return total;
+    }
+    if (quantized8) {
+        int32_t total = quantizedBias();
+        forEachTerm<Policy>(tweet, stopWords, [this, &total](std::string_view word) {
+            total += quantized8->weightOf(word);
+        });
+        return total;
+    }
+    if (quantized16) {
+        int32_t total = quantizedBias();
+        forEachTerm<Policy>(tweet, stopWords, [this, &total](std::string_view word) {
+            total += quantized16->weightOf(word);
+        });
+        return total;
+    }
+
+    int sentimentScore = scoreBias;
+    forEachTerm<Policy>(tweet, stopWords, [this, &sentimentScore](std::string_view word) {
+        const TermStats* stats = wordSentiment.find(word);
+        if (stats)
+            sentimentScore += stats->sentiment;
+    });
+    return sentimentScore;
+}
+
+int32_t SentimentClassifier::quantizedBias() const {
+    if (quantized8)
+        return scoreBias / quantized8->scaleFactor();
+    if (quantized16)
+        return scoreBias / quantized16->scaleFactor();
+    return scoreBias;
+}
+
+// Write the word counts sorted by term so model files can be merged
+void SentimentClassifier::saveModel(const std::string& modelFile) {
+    uint64_t terms = writeSortedCounts(modelFile);
+    std::cout << "Model saved to " << modelFile << " (" << terms << " terms)" << std::endl;
+}
+
+uint64_t SentimentClassifier::writeSortedCounts(const std::string& modelFile) {
+    using Entry = TermTable::value_type;
+    std::vector<const Entry*> entries;
+    entries.reserve(wordSentiment.size());
+    for (const auto& entry : wordSentiment)
+        entries.push_back(&entry);
+    std::sort(entries.begin(), entries.end(), [this](const Entry* a, const Entry* b) {
+        std::string_view termA = wordSentiment.term(a->first);
+        std::string_view termB = wordSentiment.term(b->first);
+        return termLess(termA.data(), termA.size(), termB.data(), termB.size());
+    });
+
+    ModelWriter writer;
+    if (!writer.open(modelFile, pipeline, recordOccurrences)) {
+        std::cerr << "Error opening model file: " << modelFile << std::endl;
+        exit(1);
+    }
+    for (const auto* entry : entries) {
+        std::string_view term = wordSentiment.term(entry->first);
+        writer.write(term.data(), static_cast<uint32_t>(term.size()), entry->second.sentiment, entry->second.occurrences);
+    }
+    writer.close();
+    return writer.entries();
+}
+
+// Current resident set size of this process. On Linux ru_maxrss is not
+// used: it keeps the parent's high-water mark across execve, so a large
+// parent process would make every budget look too small.
+size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    if (statm >> totalPages >> residentPages)
+        return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss); // Bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // Kilobytes elsewhere
+#endif
+}
+
+void SentimentClassifier::trainToModel(const std::string& trainingFile, const std::string& modelFile, size_t memoryBudget) {
+    if (memoryBudget == 0) {
+        train(trainingFile);
+        saveModel(modelFile);
+        return;
+    }
+
+    // Leave room for what the process already uses plus stream buffers
+    const size_t streamBytes = 1 << 20;
+    size_t baseline = residentBytes() + streamBytes;
+    if (memoryBudget < baseline + streamBytes) {
+        std::cerr << "Memory budget too small: the process needs about "
+                  << (baseline + streamBytes) / (1 << 20) + 1 << " MB before training" << std::endl;
+        exit(1);
+    }
+    tableBudget = memoryBudget - baseline;
+    spillPrefix = modelFile;
+
+    train(trainingFile);
+    if (spillRuns.empty()) {
+        saveModel(modelFile);
+        return;
+    }
+    spillRun();
+    size_t runs = spillRuns.size();
+    wordSentiment.release(); // Give the table back before merging
+
+    // Each open run costs a stream buffer; merge in rounds if there are too many
+    const size_t maxFanIn = std::max<size_t>(2, tableBudget / (64 * 1024));
+    size_t round = 0;
+    while (spillRuns.size() > maxFanIn) {
+        std::vector<std::string> merged;
+        for (size_t first = 0; first < spillRuns.size(); first += maxFanIn) {
+            std::vector<std::string> group(spillRuns.begin() + first,
+                                           spillRuns.begin() + std::min(first + maxFanIn, spillRuns.size()));
+            std::string groupFile = spillPrefix + ".merge" + std::to_string(round) + "." + std::to_string(merged.size());
+            mergeModelFiles(group, groupFile);
+            for (const auto& run : group)
+                std::remove(run.c_str());
+            merged.push_back(groupFile);
+        }
+        spillRuns.swap(merged);
+        round++;
+    }
+
+    uint64_t terms = mergeModelFiles(spillRuns, modelFile);
+    for (const auto& run : spillRuns)
+        std::remove(run.c_str());
+    spillRuns.clear();
+    std::cout << "Model saved to " << modelFile << " (" << terms << " terms, merged from " << runs << " runs)" << std::endl;
+}
+
+// Load word counts written by saveModel or mergeModelFiles
+void SentimentClassifier::loadModel(const std::string& modelFile) {
+    if (stopWords.empty())
+        loadStopWords();
+
+    ModelReader reader;
+    if (!reader.open(modelFile)) {
+        std::cerr << "Error opening model file: " << modelFile << std::endl;
+        exit(1);
+    }
+    wordSentiment.clear();
+    wordSentiment.reserve(reader.entries());
+    readModelEntries(reader, modelFile, [&]() {
+        wordSentiment[reader.term()] = TermStats{ reader.count(), reader.occurrences() };
+    });
+    scoreBias = reader.bias();
+    logisticWeights = reader.logistic();
+    pipeline = reader.pipeline();
+    std::cout << "Model loaded. Vocabulary size: " << wordSentiment.size()
+              << (reader.logistic() ? " (logistic regression)" : "");
+    if (pipeline != 0)
+        std::cout << ", pipeline: " << describePipeline(pipeline);
+    std::cout << std::endl;
+}
+
+void SentimentClassifier::enablePredictionCache(size_t capacity) {
+    predictionCache.reset(capacity ? new PredictionCache(capacity) : nullptr);
+}
+
+// Build the quantized weights used by predict
+void SentimentClassifier::quantize(const std::string& weightType, QuantizationMode mode) {
+    if (logisticWeights && mode == QuantizationMode::Clamp) {
+        // Fixed-point weights are far outside the int8/int16 range, so
+        // clamping would saturate nearly all of them against a full-scale bias
+        std::cout << "Logistic regression weights are fixed point; quantizing with scale mode" << std::endl;
+        mode = QuantizationMode::Scale;
+    }
+    quantized8.reset();
+    quantized16.reset();
+    size_t saturated = 0;
+    size_t bytes = 0;
+    int divisor = 1;
+    if (weightType == "int8") {
+        quantized8.reset(new QuantizedModel<int8_t>());
+        quantized8->build(wordSentiment, mode);
+        saturated = quantized8->saturatedCount();
+        bytes = quantized8->memoryBytes();
+        divisor = quantized8->scaleFactor();
+    }
+    else if (weightType == "int16") {
+        quantized16.reset(new QuantizedModel<int16_t>());
+        quantized16->build(wordSentiment, mode);
+        saturated = quantized16->saturatedCount();
+        bytes = quantized16->memoryBytes();
+        divisor = quantized16->scaleFactor();
+    }
+    else {
+        std::cerr << "Unknown quantized weight type: " << weightType << " (expected int8 or int16)" << std::endl;
+        exit(1);
+    }
+
+    size_t intBytes = wordSentiment.memoryBytes();
+    std::cout << "Quantized model: " << weightType << " weights, " << bytes << " bytes with keys (int model: "
+              << intBytes << " bytes with keys), scale 1/" << divisor << ", "
+              << saturated << " weights saturated" << std::endl;
+}
+
+// Score every test tweet with both models and report the accuracy delta
+void SentimentClassifier::reportQuantization(const std::string& testingFile, const std::string& groundTruthFile) {
+    if (!quantized8 && !quantized16)
+        return;
+
+    DSHashMap<long, int> groundTruthMap;
+    loadGroundTruth(groundTruthFile, groundTruthMap);
+
+    int totalTweets = 0;
+    int fullCorrect = 0;
+    int quantizedCorrect = 0;
+    int disagreements = 0;
+    dispatchPipeline(pipeline, [&](auto policy) {
+        using Policy = decltype(policy);
+        forEachTestTweet(testingFile, [&](const std::string& id, std::string_view tweet) {
+            long tweetID;
+            try {
+                tweetID = std::stol(id);
+            }
+            catch (...) {
+                return; // Header or malformed row
+            }
+            auto truth = groundTruthMap.find(tweetID);
+            if (truth == groundTruthMap.end())
+                return;
+
+            int fullScore = scoreBias;
+            int quantizedScore = quantizedBias();
+            forEachTerm<Policy>(tweet, stopWords, [&](std::string_view word) {
+                const TermStats* stats = wordSentiment.find(word);
+                if (stats)
+                    fullScore += stats->sentiment;
+                quantizedScore += quantized8 ? quantized8->weightOf(word) : quantized16->weightOf(word);
+            });
+            int fullPrediction = (fullScore >= 0) ? 4 : 0;
+            int quantizedPrediction = (quantizedScore >= 0) ? 4 : 0;
+
+            totalTweets++;
+            fullCorrect += (fullPrediction == truth->second);
+            quantizedCorrect += (quantizedPrediction == truth->second);
+            disagreements += (fullPrediction != quantizedPrediction);
+        });
+    });
+
+    double fullAccuracy = (totalTweets > 0) ? (static_cast<double>(fullCorrect) / totalTweets) * 100.0 : 0.0;
+    double quantizedAccuracy = (totalTweets > 0) ? (static_cast<double>(quantizedCorrect) / totalTweets) * 100.0 : 0.0;
+    std::cout << std::fixed << std::setprecision(3)
+              << "Quantization report: full-precision accuracy " << fullAccuracy
+              << ", quantized accuracy " << quantizedAccuracy
+              << ", delta " << (quantizedAccuracy - fullAccuracy)
+              << " (" << disagreements << " of " << totalTweets << " predictions changed)" << std::endl;
+}
+
+// Below this single-table size (about a million terms) --hot-terms only adds a probe
+static const size_t TIERED_MIN_TABLE_BYTES = 16u << 20;
+
+// Put a hot tier in front of the scoring table
+void SentimentClassifier::setHotTerms(size_t terms) {
+    tiered.reset();
+    if (terms == 0)
+        return;
+    tiered.reset(new TieredWeights());
+    withScoringTable([&](const auto& table) {
+        for (const auto& entry : wordSentiment) {
+            std::string_view term = wordSentiment.term(entry.first);
+            tiered->add(term, table.weightOf(term, table.hash(term)), entry.second.occurrences);
+        }
+        tiered->build(terms, table);
+    });
+    std::cout << "Tiered weights: " << tiered->hotSize() << " hot terms in " << tiered->hotBytes() / 1024
+              << " KB in front of the table of " << tiered->size() << " terms, ranked by "
+              << (tiered->rankedByOccurrences() ? "training occurrences" : "weight magnitude") << std::endl;
+    size_t tableBytes = wordSentiment.memoryBytes();
+    if (tableBytes < TIERED_MIN_TABLE_BYTES)
+        std::cout << "Note: the single table (" << tableBytes / 1024 << " KB) already fits in cache; "
+                  << "tiered lookups will be slower for this model" << std::endl;
+}
+
+// Tokenize the test set once, then time lookups of every token through the
+// single table and through the tiers (best of a few passes each)
+void SentimentClassifier::reportTiers(const std::string& testingFile) {
+    if (!tiered)
+        return;
+
+    std::string tokenBytes;
+    std::vector<std::pair<uint32_t, uint32_t>> tokens; // Offset and length into tokenBytes
+    dispatchPipeline(pipeline, [&](auto policy) {
+        using Policy = decltype(policy);
+        forEachTestTweet(testingFile, [&](const std::string&, std::string_view tweet) {
+            forEachTerm<Policy>(tweet, stopWords, [&](std::string_view word) {
+                tokens.emplace_back(static_cast<uint32_t>(tokenBytes.size()), static_cast<uint32_t>(word.size()));
+                tokenBytes.append(word.data(), word.size());
+            });
+        });
+    });
+    if (tokens.empty())
+        return;
+
+    size_t hits[3] = { 0, 0, 0 }; // Hot, cold, missing
+    withScoringTable([&](const auto& table) {
+        for (const auto& token : tokens) {
+            std::string_view word(tokenBytes.data() + token.first, token.second);
+            int32_t weight;
+            if (tiered->findHot(word, table.hash(word), weight))
+                hits[0]++;
+            else if (wordSentiment.find(word))
+                hits[1]++;
+            else
+                hits[2]++;
+        }
+    });
+
+    const int passes = 5;
+    auto bestNanos = [&](auto&& lookup) {
+        double best = 0.0;
+        for (int pass = 0; pass < passes; ++pass) {
+            int64_t sum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& token : tokens)
+                sum += lookup(std::string_view(tokenBytes.data() + token.first, token.second));
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            volatile int64_t sink = sum; // Keep the lookups from being optimized away
+            (void)sink;
+            double perToken = elapsed.count() / tokens.size();
+            if (pass == 0 || perToken < best)
+                best = perToken;
+        }
+        return best;
+    };
+    double singleNanos = 0.0;
+    double tieredNanos = 0.0;
+    withScoringTable([&](const auto& table) {
+        singleNanos = bestNanos([&](std::string_view word) -> int64_t {
+            return table.weightOf(word, table.hash(word));
+        });
+        tieredNanos = bestNanos([&](std::string_view word) -> int64_t {
+            return tiered->weightOf(word, table);
+        });
+    });
+
+    double total = static_cast<double>(tokens.size());
+    std::cout << std::fixed << std::setprecision(2)
+              << "Tier report: " << tokens.size() << " test tokens, hot " << hits[0] * 100.0 / total
+              << "%, cold " << hits[1] * 100.0 / total << "%, missing " << hits[2] * 100.0 / total
+              << "%; lookup " << singleNanos << " ns/token single table, " << tieredNanos
+              << " ns/token tiered" << std::endl;
+}
+
+// Rough vocabulary size of a training file, from Heaps' law V = K * n^0.6
+// with K fitted to the bundled tweets (about 30k terms in a 2.7 MB CSV)
+size_t estimateVocabulary(const std::string& trainingFile) {
+    struct stat st;
+    if (stat(trainingFile.c_str(), &st) != 0 || st.st_size <= 0)
+        return 0;
+    double tokens = static_cast<double>(st.st_size) / 12.0;
+    return static_cast<size_t>(20.0 * std::pow(tokens, 0.6));
+}
+
+// Training function
+void SentimentClassifier::train(const std::string& trainingFile) {
+    loadStopWords();
+    size_t expectedTerms = estimateVocabulary(trainingFile);
+    if (tableBudget != 0) // About 35 table + 10 key + 8 sort bytes per term, with headroom
+        expectedTerms = std::min(expectedTerms, tableBudget / 128);
+    wordSentiment.reserve(expectedTerms);
+
+    dispatchPipeline(pipeline, [this, &trainingFile](auto policy) {
+        forEachTrainingTweet(trainingFile, [this](int sentiment, std::string_view tweet) {
+            learnTweet<decltype(policy)>(sentiment, tweet);
+        });
+    });
+
+    std::cout << "Training completed. Vocabulary size: " << wordSentiment.size();
+    if (!spillRuns.empty())
+        std::cout << " in memory, " << spillRuns.size() << " runs spilled";
+    if (pipeline != 0)
+        std::cout << ", pipeline: " << describePipeline(pipeline);
+    std::cout << std::endl;
+}
+
+void SentimentClassifier::trainLogistic(const std::string& trainingFile, const LogisticOptions& options, const std::string& modelFile) {
+    if (stopWords.empty())
+        loadStopWords();
+
+    LogisticTrainer trainer;
+    unsigned workers = LogisticTrainer::workerCount(options);
+    dispatchPipeline(pipeline, [&](auto policy) {
+        using Policy = decltype(policy);
+        forEachTrainingTweet(trainingFile, [&](int sentiment, std::string_view tweet) {
+            trainer.addExample(sentiment, tweet);
+            if (trainer.pendingExamples() == LOGISTIC_BLOCK_EXAMPLES)
+                trainer.tokenizePending<Policy>(stopWords, workers);
+        });
+        trainer.tokenizePending<Policy>(stopWords, workers);
+    });
+    trainer.train(options);
+    std::cout << "Training completed. Vocabulary size: " << trainer.vocabularySize() << " (logistic regression, "
+              << trainer.examples() << " examples, " << options.epochs << " epochs)" << std::endl;
+
+    if (!modelFile.empty())
+        trainer.save(modelFile, pipeline, recordOccurrences);
+
+    wordSentiment.clear();
+    wordSentiment.reserve(trainer.vocabularySize());
+    trainer.forEachWeight([this](const DSString& term, float weight, uint32_t occurrences) {
+        wordSentiment[std::string_view(term.c_str(), term.length())] = TermStats{ toFixedPoint(weight), occurrences };
+    });
+    scoreBias = toFixedPoint(trainer.bias());
+    logisticWeights = true;
+}
+
+// One results line, "<4|0>, <id>"; the label is 4 when score >= 0
+void writePrediction(LineWriter& results, int score, std::string_view id) {
+    results.write((score >= 0) ? "4, " : "0, ");
+    results.write(id);
+    results.write("\n");
+}
+
+// Prediction function
+void SentimentClassifier::predict(const std::string& testingFile, const std::string& resultsFile) {
+    LineWriter results;
+    if (!results.open(resultsFile, ioBackend)) {
+        std::cerr << "Error opening results file: " << resultsFile << std::endl;
+        exit(1);
+    }
+
+    dispatchPipeline(pipeline, [&](auto policy) {
+        using Policy = decltype(policy);
+        if (batchSize > 0) {
+            predictBatched<Policy>(testingFile, results);
+            return;
+        }
+        forEachTestTweet(testingFile, [&](const std::string& id, std::string_view tweet) {
+            int sentimentScore = scoreTweet<Policy>(tweet);
+            writePrediction(results, sentimentScore, id);
+        });
+    });
+
+    results.close();
+    std::cout << "Prediction completed. Results saved to " << resultsFile << std::endl;
+    reportPredictionCache();
+}
+
+// Hits and misses of the prediction cache, if one is enabled
+void SentimentClassifier::reportPredictionCache() const {
+    if (!predictionCache)
+        return;
+    uint64_t hits = predictionCache->hits();
+    uint64_t lookups = hits + predictionCache->misses();
+    double hitRate = (lookups > 0) ? (static_cast<double>(hits) / lookups) * 100.0 : 0.0;
+    std::cout << std::fixed << std::setprecision(1)
+              << "Prediction cache: " << hits << " hits, " << (lookups - hits) << " misses ("
+              << hitRate << "% hit rate, " << predictionCache->capacity() << " entries)" << std::endl;
+}
+
+void SentimentClassifier::predictEnsemble(const std::string& testingFile, const std::string& resultsFile,
+                                          const ModelEnsemble& ensemble, EnsembleVote vote) {
+    if (stopWords.empty())
+        loadStopWords();
+    pipeline = ensemble.pipeline();
+
+    LineWriter results;
+    if (!results.open(resultsFile, ioBackend)) {
+        std::cerr << "Error opening results file: " << resultsFile << std::endl;
+        exit(1);
+    }
+
+    std::vector<int32_t> scores(ensemble.models());
+    uint64_t tweets = 0;
+    uint64_t unanimous = 0;
+    dispatchPipeline(pipeline, [&](auto policy) {
+        using Policy = decltype(policy);
+        forEachTestTweet(testingFile, [&](const std::string& id, std::string_view tweet) {
+            ensemble.startScores(scores.data());
+            forEachTerm<Policy>(tweet, stopWords, [&](std::string_view word) {
+                ensemble.addTerm(word, scores.data());
+            });
+
+            size_t positive = 0;
+            for (size_t model = 0; model < scores.size(); ++model)
+                positive += ensemble.positive(scores.data(), model);
+            tweets++;
+            unanimous += (positive == 0 || positive == scores.size());
+
+            if (vote == EnsembleVote::Columns) { // "4, 0, 4, <id>"
+                for (size_t model = 0; model < scores.size(); ++model)
+                    results.write(ensemble.positive(scores.data(), model) ? "4, " : "0, ");
+                results.write(id);
+                results.write("\n");
+            }
+            else {
+                writePrediction(results, ensemble.vote(scores.data()), id);
+            }
+        });
+    });
+
+    results.close();
+    double share = (tweets > 0) ? (static_cast<double>(unanimous) / tweets) * 100.0 : 0.0;
+    std::cout << std::fixed << std::setprecision(1)
+              << "Prediction completed. Results saved to " << resultsFile << " (" << share
+              << "% of tweets predicted the same by every model)" << std::endl;
+}
+
+void SentimentClassifier::aggregate(const std::string& testingFile, SentimentAggregator& aggregator) {
+    dispatchPipeline(pipeline, [&](auto policy) {
+        using Policy = decltype(policy);
+        forEachDatedTweet(testingFile, [&](std::string_view date, std::string_view user, std::string_view tweet) {
+            aggregator.add(date, user, scoreTweet<Policy>(tweet));
+        });
+    });
+}
+
+// Read ground truth labels keyed by tweet ID from a CSV or columnar file
+void SentimentClassifier::loadGroundTruth(const std::string& groundTruthFile, DSHashMap<long, int>& groundTruthMap) {
+    bool columnarTruth = ColumnarDataset::isColumnar(groundTruthFile);
+    if (columnarTruth) {
+        ColumnarDataset truth;
+        if (!truth.open(groundTruthFile) || !truth.has(COL_LABEL)) {
+            std::cerr << "Invalid columnar ground truth file: " << groundTruthFile << std::endl;
+            exit(1);
+        }
+        truth.willNeed(COL_ID | COL_LABEL);
+        groundTruthMap.reserve(truth.rows());
+        for (size_t row = 0; row < truth.rows(); ++row)
+            groundTruthMap[static_cast<long>(truth.id(row))] = truth.label(row);
+    }
+
+    LineReader groundTruth;
+    if (!columnarTruth && !groundTruth.open(groundTruthFile, ioBackend)) {
+        std::cerr << "Error opening ground truth file: " << groundTruthFile << std::endl;
+        exit(1);
+    }
+    std::string_view truthLine;
+    std::string_view fields[2];
+    while (!columnarTruth && groundTruth.next(truthLine)) {
+        if (!splitCsvFields(truthLine, fields, 2)) continue;
+        int sentiment;
+        long tweetID;
+        try {
+            sentiment = std::stoi(std::string(fields[0]));
+            tweetID = std::stol(std::string(fields[1].substr(0, fields[1].find(','))));
+        }
+        catch (...) {
+            continue; // Invalid data
+        }
+        groundTruthMap[tweetID] = sentiment;
+    }
+    groundTruth.close();
+}
+
+// Prediction in blocks of batchSize tweets through BatchScorer
+template <typename Policy>
+void SentimentClassifier::predictBatched(const std::string& testingFile, LineWriter& results) {
+    BatchScorer scorer;
+    scorer.setBias(quantizedBias());
+
+    // Per-row state of the current block; cached rows are added without terms
+    std::vector<std::string> ids;
+    std::vector<uint64_t> textHashes;
+    std::vector<int> cachedScores;
+    std::vector<bool> cachedRows;
+    std::vector<int32_t> scores;
+
+    auto flush = [&]() {
+        withScoringTable([&](const auto& table) { scorer.score(table, scores); });
+        for (size_t row = 0; row < ids.size(); ++row) {
+            int sentimentScore = scores[row];
+            if (cachedRows[row])
+                sentimentScore = cachedScores[row];
+            else if (predictionCache)
+                predictionCache->insert(textHashes[row], sentimentScore);
+            writePrediction(results, sentimentScore, ids[row]);
+        }
+        ids.clear();
+        textHashes.clear();
+        cachedScores.clear();
+        cachedRows.clear();
+    };
+
+    forEachTestTweet(testingFile, [&](const std::string& id, std::string_view text) {
+        uint64_t textHash = 0;
+        int cachedScore = 0;
+        bool cached = false;
+        if (predictionCache) {
+            textHash = hashText(text);
+            cached = predictionCache->lookup(textHash, cachedScore);
+        }
+        scorer.addTweet<Policy>(cached ? std::string_view() : text, stopWords);
+        ids.push_back(id);
+        textHashes.push_back(textHash);
+        cachedScores.push_back(cachedScore);
+        cachedRows.push_back(cached);
+        if (ids.size() == batchSize)
+            flush();
+    });
+    if (!ids.empty())
+        flush();
+}
+
+// Evaluation function
+void SentimentClassifier::evaluatePredictions(const std::string& groundTruthFile, const std::string& resultsFile, const std::string& accuracyFile) {
+    LineReader results;
+    if (!results.open(resultsFile, ioBackend)) {
+        std::cerr << "Error opening results file: " << resultsFile << std::endl;
+        exit(1);
+    }
+
+    LineWriter accuracyOut;
+    if (!accuracyOut.open(accuracyFile, ioBackend)) {
+        std::cerr << "Error opening accuracy file: " << accuracyFile << std::endl;
+        exit(1);
+    }
+
+    // Read ground truth into a map
+    DSHashMap<long, int> groundTruthMap;
+    loadGroundTruth(groundTruthFile, groundTruthMap);
+
+    // Read predictions
+    std::vector<std::pair<int, long>> predictions; // pair<predicted sentiment, tweetID>
+    std::string_view resultLine;
+    std::string_view fields[2];
+    while (results.next(resultLine)) {
+        if (!splitCsvFields(resultLine, fields, 2)) continue;
+        std::string_view idStr = fields[1].substr(0, fields[1].find(','));
+        int sentiment;
+        long tweetID;
+        try {
+            sentiment = std::stoi(std::string(fields[0]));
+            // Remove possible leading/trailing spaces from idStr
+            size_t start = idStr.find_first_not_of(" \t");
+            size_t end = idStr.find_last_not_of(" \t");
+            std::string trimmedId = (start == std::string::npos) ? "" : std::string(idStr.substr(start, end - start + 1));
+            tweetID = std::stol(trimmedId);
+        }
+        catch (...) {
+            continue; // Invalid data
+        }
+        predictions.emplace_back(sentiment, tweetID);
+    }
+    results.close();
+
+    // Compare predictions with ground truth
+    int totalTweets = 0;
+    int correctPredictions = 0;
+    std::vector<std::tuple<int, int, long>> misclassifications; // ground truth, prediction, tweet ID
+
+    for (const auto& pred : predictions) {
+        int predicted = pred.first;
+        long tweetID = pred.second;
+        auto it = groundTruthMap.find(tweetID);
+        if (it != groundTruthMap.end()) {
+            int actual = it->second;
+            if (predicted == actual) {
+                correctPredictions++;
+            }
+            else {
+                misclassifications.emplace_back(actual, predicted, tweetID);
+            }
+            totalTweets++;
+        }
+    }
+
+    // Calculate accuracy
+    double accuracyValue = (totalTweets > 0) ? (static_cast<double>(correctPredictions) / totalTweets) * 100.0 : 0.0;
+
+    // Write accuracy first
+    char text[64];
+    accuracyOut.write(std::string_view(text, static_cast<size_t>(std::snprintf(text, sizeof(text), "%.3f\n", accuracyValue))));
+
+    // Write misclassifications
+    for (const auto& mis : misclassifications) {
+        int length = std::snprintf(text, sizeof(text), "%d, %d, %ld\n", std::get<0>(mis), std::get<1>(mis), std::get<2>(mis));
+        accuracyOut.write(std::string_view(text, static_cast<size_t>(length)));
+    }
+
+    accuracyOut.close();
+    std::cout << "Evaluation completed. Accuracy saved to " << accuracyFile << std::endl;
+}
+
+#endif // SENTIMENT_LIBRARY
+
+} // namespace
+
+// ----------------------- Library API -----------------------
+namespace sentiment {
+
+// Read-only model shared by every Model handle
+class FrozenModel {
+public:
+    // Throws std::runtime_error if the file cannot be read
+    void load(const std::string& modelFile);
+
+    // Tokenizes with the pipeline the model was trained with
+    int32_t score(std::string_view tweet) const {
+        int32_t total = bias;
+        dispatchPipeline(pipeline, [this, tweet, &total](auto policy) {
+            forEachTerm<decltype(policy)>(tweet, stopWords, [this, &total](std::string_view term) {
+                uint32_t id = vocabulary.lookup(term);
+                if (id != VocabularyIndex::npos)
+                    total += weights[id];
+            });
+        });
+        return total;
+    }
+
+    size_t size() const { return weights.size(); }
+
+private:
+    VocabularyIndex vocabulary;
+    std::vector<int32_t> weights; // Indexed by vocabulary ID
+    int32_t bias = 0;
+    uint32_t pipeline = 0;
+    StopWordSet stopWords;
+};
+
+void FrozenModel::load(const std::string& modelFile) {
+    ModelReader reader;
+    if (!reader.open(modelFile))
+        throw std::runtime_error("Error opening model file: " + modelFile);
+    loadDefaultStopWords(stopWords);
+    size_t expected = static_cast<size_t>(std::min<uint64_t>(reader.entries(), 1u << 24)); // The count may come from a damaged header
+    vocabulary.reserve(expected);
+    weights.reserve(expected);
+    while (reader.next()) {
+        vocabulary.add(DSString(reader.term().data(), reader.term().size()));
+        weights.push_back(reader.count());
+    }
+    if (reader.truncated())
+        throw std::runtime_error("Truncated model file: " + modelFile);
+    bias = reader.bias();
+    pipeline = reader.pipeline();
+}
+
+Model Model::load(const std::string& modelFile) {
+    std::shared_ptr<FrozenModel> loaded = std::make_shared<FrozenModel>();
+    loaded->load(modelFile);
+    return Model(loaded);
+}
+
+Classification Model::classify(std::string_view tweet) const {
+    int32_t score = frozen->score(tweet);
+    return { (score >= 0) ? 4 : 0, score };
+}
+
+void Model::classify(const std::string_view* tweets, size_t count, Classification* results) const {
+    for (size_t i = 0; i < count; ++i)
+        results[i] = classify(tweets[i]);
+}
+
+size_t Model::vocabularySize() const {
+    return frozen->size();
+}
+
+} // namespace sentiment
+
+// --------------------------- Main Function ---------------------------
+#ifndef SENTIMENT_LIBRARY
+void printUsage() {
+    std::cerr << "Usage: ./sentiment <trainingFile> <testingFile> <groundTruthFile> <resultsFile> <accuracyFile>" << std::endl;
+    std::cerr << "                   [--model counts|logistic] [logistic options] [pipeline options] [prediction options] [--io <backend>]" << std::endl;
+    std::cerr << "       ./sentiment convert <train|test|truth> <input.csv> <output.col> [--no-meta]" << std::endl;
+    std::cerr << "       ./sentiment train-partial <shard.csv> -o <part.model> [--memory-budget <MB>] [--occurrences] [pipeline options] [--io <backend>]" << std::endl;
+    std::cerr << "       ./sentiment train-logistic <trainingFile> -o <model.bin> [logistic options] [--occurrences] [pipeline options] [--io <backend>]" << std::endl;
+    std::cerr << "         --occurrences also records each term's training count, which --hot-terms ranks by" << std::endl;
+    std::cerr << "         (merge keeps the counts only if every part has them)" << std::endl;
+    std::cerr << "       ./sentiment merge <part.model>... -o <model.bin>" << std::endl;
+    std::cerr << "       ./sentiment predict <testingFile> <resultsFile> <model.bin> [prediction options] [--io <backend>]" << std::endl;
+    std::cerr << "       ./sentiment predict <testingFile> <resultsFile> <model.bin>... [--ensemble columns|majority|weighted]" << std::endl;
+    std::cerr << "                   [--vote-weights <w1,w2,...>] [--thresholds <t1,t2,...>] [--io <backend>]" << std::endl;
+    std::cerr << "         scores every model in one pass (models must share case, stemming and bigram options;" << std::endl;
+    std::cerr << "         unigram models may differ in stop words); a model predicts positive when its score is" << std::endl;
+    std::cerr << "         at least its threshold (default 0; logit for logistic models); columns writes one" << std::endl;
+    std::cerr << "         prediction per model before the id, majority and weighted write the ensemble vote" << std::endl;
+    std::cerr << "       ./sentiment aggregate <testingFile> <model.bin> -o <prefix> [--window <n>[s|m|h|d]] [--top-users <k>]" << std::endl;
+    std::cerr << "                   [--quantize ...] [--cache ...] [--io <backend>]" << std::endl;
+    std::cerr << "         writes <prefix>.windows.csv (per time window, default 1h) and <prefix>.users.csv" << std::endl;
+    std::cerr << "         (Space-Saving top users, default 1000)" << std::endl;
+    std::cerr << "Logistic options:" << std::endl;
+    std::cerr << "  --epochs <n>                      passes over the training data (default 5)" << std::endl;
+    std::cerr << "  --learning-rate <rate>            initial SGD step, decayed as rate/(1+epoch) (default 0.1)" << std::endl;
+    std::cerr << "  --threads <n>                     Hogwild SGD threads (default: all cores)" << std::endl;
+    std::cerr << "Pipeline options (stored in the model; predict and merge take them from the model files):" << std::endl;
+    std::cerr << "  --no-lowercase                    keep the case of terms" << std::endl;
+    std::cerr << "  --no-stem                         do not strip -ing, -ed and -s suffixes" << std::endl;
+    std::cerr << "  --no-stopwords                    keep stop words" << std::endl;
+    std::cerr << "  --bigrams                         add adjacent term pairs to the features" << std::endl;
+    std::cerr << "Prediction options:" << std::endl;
+    std::cerr << "  --quantize <int8|int16>[:scale]   predict with clamped (or scaled) compact weights" << std::endl;
+    std::cerr << "                                    (logistic models are always scaled)" << std::endl;
+    std::cerr << "  --cache <entries>                 reuse scores of repeated tweet text" << std::endl;
+    std::cerr << "  --batch-size <rows>               score tweets in blocks with the batched kernel" << std::endl;
+    std::cerr << "                                    (measured no faster than per-tweet scoring)" << std::endl;
+    std::cerr << "  --hot-terms <n>                   keep the n most frequent training terms (heaviest weights if the model" << std::endl;
+    std::cerr << "                                    has no --occurrences counts) in a compact hot tier;" << std::endl;
+    std::cerr << "                                    only for models too large for the CPU caches (~1M+ terms)" << std::endl;
+    std::cerr << "I/O backends for CSV inputs and result files (--io):" << std::endl;
+    std::cerr << "  stream                            buffered iostreams (default)" << std::endl;
+    std::cerr << "  pread                             1 MB pread/pwrite chunks" << std::endl;
+    std::cerr << "  uring                             io_uring with reads ahead and asynchronous writes (falls back to pread)" << std::endl;
+}
+
+// Positional arguments plus "--name value" options. Names listed in
+// switches take no value and are stored as "1"; any option not listed in
+// switches or options is rejected.
+struct CommandLine {
+    std::vector<std::string> positional;
+    std::map<std::string, std::string> options;
+
+    bool has(const std::string& name) const { return options.count(name) > 0; }
+    std::string get(const std::string& name, const std::string& fallback = "") const {
+        auto it = options.find(name);
+        return (it != options.end()) ? it->second : fallback;
+    }
+};
+
+bool parseCommandLine(int argc, char* argv[], const std::vector<std::string>& switches,
+                      const std::vector<std::string>& options, CommandLine& commandLine) {
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.size() < 2 || arg[0] != '-') {
+            commandLine.positional.push_back(arg);
+            continue;
+        }
+        if (std::find(switches.begin(), switches.end(), arg) != switches.end()) {
+            commandLine.options[arg] = "1";
+            continue;
+        }
+        if (std::find(options.begin(), options.end(), arg) == options.end()) {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for option " << arg << std::endl;
+            return false;
+        }
+        commandLine.options[arg] = argv[++i];
+    }
+    return true;
+}
+
+// Concatenate option lists for parseCommandLine
+std::vector<std::string> optionList(std::initializer_list<std::vector<std::string>> groups) {
+    std::vector<std::string> names;
+    for (const auto& group : groups)
+        names.insert(names.end(), group.begin(), group.end());
+    return names;
+}
+
+// Options read by applyPredictOptions and parseLogisticOptions
+static const std::vector<std::string> PREDICT_OPTIONS = { "--quantize", "--cache", "--batch-size", "--hot-terms" };
+static const std::vector<std::string> LOGISTIC_OPTIONS = { "--epochs", "--learning-rate", "--threads" };
+
+// Non-negative decimal count; std::stoul alone accepts "-5" and wraps it
+bool parseCount(const std::string& text, size_t& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0])))
+        return false;
+    try {
+        size_t used = 0;
+        unsigned long long parsed = std::stoull(text, &used);
+        if (used != text.size())
+            return false;
+        value = static_cast<size_t>(parsed);
+    }
+    catch (...) {
+        return false;
+    }
+    return true;
+}
+
+// sentiment convert <train|test|truth> <input.csv> <output.col> [--no-meta]
+int convertCommand(int argc, char* argv[]) {
+    CommandLine commandLine;
+    if (!parseCommandLine(argc, argv, { "--no-meta" }, {}, commandLine) || commandLine.positional.size() != 3) {
+        printUsage();
+        return 1;
+    }
+    const auto& args = commandLine.positional;
+    convertToColumnar(args[0], args[1], args[2], !commandLine.has("--no-meta"));
+    return 0;
+}
+
+// Switches selecting the tokenization pipeline (PipelineFlags)
+static const std::vector<std::string> PIPELINE_SWITCHES = { "--no-lowercase", "--no-stem", "--no-stopwords", "--bigrams" };
+
+uint32_t pipelineFromCommandLine(const CommandLine& commandLine) {
+    uint32_t flags = 0;
+    if (commandLine.has("--no-lowercase"))
+        flags |= PIPELINE_NO_LOWERCASE;
+    if (commandLine.has("--no-stem"))
+        flags |= PIPELINE_NO_STEM;
+    if (commandLine.has("--no-stopwords"))
+        flags |= PIPELINE_NO_STOP_WORDS;
+    if (commandLine.has("--bigrams"))
+        flags |= PIPELINE_BIGRAMS;
+    return flags;
+}
+
+// Read --io
+bool applyIoOption(const CommandLine& commandLine, SentimentClassifier& classifier) {
+    IoBackend backend = IoBackend::Stream;
+    if (!parseIoBackend(commandLine.get("--io", "stream"), backend))
+        return false;
+    classifier.setIoBackend(backend);
+    return true;
+}
+
+// sentiment train-partial <shard.csv> -o <part.model> [--memory-budget <MB>] [--occurrences] [pipeline options] [--io <backend>]
+int trainPartialCommand(int argc, char* argv[]) {
+    CommandLine commandLine;
+    if (!parseCommandLine(argc, argv, optionList({ PIPELINE_SWITCHES, { "--occurrences" } }), { "-o", "--memory-budget", "--io" }, commandLine) ||
+        commandLine.positional.size() != 1 || !commandLine.has("-o")) {
+        printUsage();
+        return 1;
+    }
+    size_t memoryBudget = 0;
+    try {
+        double megabytes = std::stod(commandLine.get("--memory-budget", "0"));
+        if (!(megabytes >= 0))
+            throw std::invalid_argument("negative budget");
+        memoryBudget = static_cast<size_t>(megabytes * (1 << 20));
+    }
+    catch (...) {
+        printUsage();
+        return 1;
+    }
+    SentimentClassifier classifier;
+    classifier.setPipeline(pipelineFromCommandLine(commandLine));
+    classifier.setRecordOccurrences(commandLine.has("--occurrences"));
+    if (!applyIoOption(commandLine, classifier)) {
+        printUsage();
+        return 1;
+    }
+    classifier.trainToModel(commandLine.positional[0], commandLine.get("-o"), memoryBudget);
+    return 0;
+}
+
+// Read --epochs, --learning-rate and --threads
+bool parseLogisticOptions(const CommandLine& commandLine, LogisticOptions& options) {
+    size_t epochs = static_cast<size_t>(options.epochs);
+    size_t threads = 0;
+    if (!parseCount(commandLine.get("--epochs", std::to_string(options.epochs)), epochs) ||
+        !parseCount(commandLine.get("--threads", "0"), threads) ||
+        epochs > static_cast<size_t>(std::numeric_limits<int>::max()) ||
+        threads > std::numeric_limits<unsigned>::max())
+        return false;
+    options.epochs = static_cast<int>(epochs);
+    options.threads = static_cast<unsigned>(threads);
+    try {
+        options.learningRate = std::stof(commandLine.get("--learning-rate", std::to_string(options.learningRate)));
+    }
+    catch (...) {
+        return false;
+    }
+    return options.epochs > 0 && options.learningRate > 0;
+}
+
+// sentiment train-logistic <training.csv> -o <model.bin> [logistic options] [--occurrences] [pipeline options] [--io <backend>]
+int trainLogisticCommand(int argc, char* argv[]) {
+    CommandLine commandLine;
+    LogisticOptions options;
+    SentimentClassifier classifier;
+    if (!parseCommandLine(argc, argv, optionList({ PIPELINE_SWITCHES, { "--occurrences" } }), optionList({ { "-o", "--io" }, LOGISTIC_OPTIONS }), commandLine) ||
+        commandLine.positional.size() != 1 || !commandLine.has("-o") || !parseLogisticOptions(commandLine, options) || !applyIoOption(commandLine, classifier)) {
+        printUsage();
+        return 1;
+    }
+    classifier.setPipeline(pipelineFromCommandLine(commandLine));
+    classifier.setRecordOccurrences(commandLine.has("--occurrences"));
+    classifier.trainLogistic(commandLine.positional[0], options, commandLine.get("-o"));
+    return 0;
+}
+
+// sentiment merge <part.model>... -o <model.bin>
+int mergeCommand(int argc, char* argv[]) {
+    CommandLine commandLine;
+    if (!parseCommandLine(argc, argv, {}, { "-o" }, commandLine) || commandLine.positional.empty() || !commandLine.has("-o")) {
+        printUsage();
+        return 1;
+    }
+    uint64_t terms = mergeModelFiles(commandLine.positional, commandLine.get("-o"));
+    std::cout << "Merge completed. " << commandLine.positional.size() << " models, " << terms
+              << " terms written to " << commandLine.get("-o") << std::endl;
+    return 0;
+}
+
+// Apply the prediction options shared by the default mode and predict
+bool applyPredictOptions(const CommandLine& commandLine, SentimentClassifier& classifier) {
+    std::string quantize = commandLine.get("--quantize");
+    if (!quantize.empty()) {
+        size_t colon = quantize.find(':');
+        QuantizationMode mode = QuantizationMode::Clamp;
+        if (colon != std::string::npos) {
+            if (quantize.substr(colon + 1) != "scale")
+                return false;
+            mode = QuantizationMode::Scale;
+        }
+        classifier.quantize(quantize.substr(0, colon), mode);
+    }
+
+    if (commandLine.has("--hot-terms")) { // After --quantize so the tiers hold the quantized weights
+        size_t value = 0;
+        if (!parseCount(commandLine.get("--hot-terms"), value))
+            return false;
+        classifier.setHotTerms(value);
+    }
+
+    if (commandLine.has("--batch-size")) {
+        size_t value = 0;
+        if (!parseCount(commandLine.get("--batch-size"), value))
+            return false;
+        classifier.setBatchSize(value);
+    }
+
+    if (commandLine.has("--cache")) {
+        size_t value = 0;
+        if (!parseCount(commandLine.get("--cache"), value))
+            return false;
+        classifier.enablePredictionCache(value);
+    }
+    return true;
+}
+
+// sentiment predict <testingFile> <resultsFile> <model.bin>... [--ensemble <vote>] [--vote-weights <w,...>]
+//                   [--thresholds <t,...>] [prediction options] [--io <backend>]
+int predictCommand(int argc, char* argv[]) {
+    CommandLine commandLine;
+    SentimentClassifier classifier;
+    if (!parseCommandLine(argc, argv, {}, optionList({ { "--io", "--ensemble", "--vote-weights", "--thresholds" }, PREDICT_OPTIONS }), commandLine) ||
+        commandLine.positional.size() < 3 ||
+        !applyIoOption(commandLine, classifier)) {
+        printUsage();
+        return 1;
+    }
+
+    if (commandLine.positional.size() > 3 || commandLine.has("--ensemble") || commandLine.has("--thresholds")) {
+        EnsembleVote vote = EnsembleVote::Columns;
+        if (!parseEnsembleVote(commandLine.get("--ensemble", "columns"), vote) ||
+            commandLine.has("--quantize") || commandLine.has("--cache") ||
+            commandLine.has("--batch-size") || commandLine.has("--hot-terms")) {
+            printUsage();
+            return 1;
+        }
+        ModelEnsemble ensemble;
+        ensemble.load(std::vector<std::string>(commandLine.positional.begin() + 2, commandLine.positional.end()));
+        if ((commandLine.has("--vote-weights") &&
+             (vote != EnsembleVote::Weighted || !ensemble.setVoteWeights(commandLine.get("--vote-weights")))) ||
+            (commandLine.has("--thresholds") && !ensemble.setThresholds(commandLine.get("--thresholds")))) {
+            printUsage();
+            return 1;
+        }
+        classifier.predictEnsemble(commandLine.positional[0], commandLine.positional[1], ensemble, vote);
+        return 0;
+    }
+
+    classifier.loadModel(commandLine.positional[2]);
+    if (!applyPredictOptions(commandLine, classifier)) {
+        printUsage();
+        return 1;
+    }
+    classifier.predict(commandLine.positional[0], commandLine.positional[1]);
+    classifier.reportTiers(commandLine.positional[0]);
+    return 0;
+}
+
+// "90", "90s", "15m", "1h" or "1d" as seconds
+bool parseDuration(const std::string& text, int64_t& seconds) {
+    size_t used = 0;
+    try {
+        seconds = std::stoll(text, &used);
+    }
+    catch (...) {
+        return false;
+    }
+    std::string unit = text.substr(used);
+    if (unit == "m")
+        seconds *= 60;
+    else if (unit == "h")
+        seconds *= 3600;
+    else if (unit == "d")
+        seconds *= 86400;
+    else if (!unit.empty() && unit != "s")
+        return false;
+    return seconds > 0;
+}
+
+// sentiment aggregate <testingFile> <model.bin> -o <prefix> [--window <n>[s|m|h|d]] [--top-users <k>] [...]
+int aggregateCommand(int argc, char* argv[]) {
+    CommandLine commandLine;
+    int64_t window = 0;
+    size_t topUsers = 0;
+    IoBackend backend = IoBackend::Stream;
+    if (!parseCommandLine(argc, argv, {}, optionList({ { "-o", "--window", "--top-users", "--io" }, PREDICT_OPTIONS }), commandLine) ||
+        commandLine.positional.size() != 2 || !commandLine.has("-o") ||
+        !parseDuration(commandLine.get("--window", "1h"), window) ||
+        !parseCount(commandLine.get("--top-users", "1000"), topUsers) ||
+        !parseIoBackend(commandLine.get("--io", "stream"), backend)) {
+        printUsage();
+        return 1;
+    }
+
+    SentimentClassifier classifier;
+    classifier.setIoBackend(backend);
+    classifier.loadModel(commandLine.positional[1]);
+    if (!applyPredictOptions(commandLine, classifier)) {
+        printUsage();
+        return 1;
+    }
+    SentimentAggregator aggregator(window, topUsers);
+    classifier.aggregate(commandLine.positional[0], aggregator);
+    aggregator.write(commandLine.get("-o"), backend);
+    classifier.reportPredictionCache();
+    return 0;
 }
 
-// --------------------------- Main Function ---------------------------
 int main(int argc, char* argv[]) {
-    if (argc != 6) { // Expecting 5 arguments + program name
-        std::cerr << "Usage: ./sentiment <trainingFile> <testingFile> <groundTruthFile> <resultsFile> <accuracyFile>" << std::endl;
+    std::string command = (argc > 1) ? argv[1] : "";
+    if (command == "convert")
+        return convertCommand(argc - 2, argv + 2);
+    if (command == "train-partial")
+        return trainPartialCommand(argc - 2, argv + 2);
+    if (command == "train-logistic")
+        return trainLogisticCommand(argc - 2, argv + 2);
+    if (command == "merge")
+        return mergeCommand(argc - 2, argv + 2);
+    if (command == "predict")
+        return predictCommand(argc - 2, argv + 2);
+    if (command == "aggregate")
+        return aggregateCommand(argc - 2, argv + 2);
+
+    CommandLine commandLine;
+    if (!parseCommandLine(argc - 1, argv + 1, PIPELINE_SWITCHES, optionList({ { "--model", "--io" }, LOGISTIC_OPTIONS, PREDICT_OPTIONS }), commandLine) ||
+        commandLine.positional.size() != 5) { // Expecting 5 files
+        printUsage();
         return 1;
     }
 
-    std::string trainingFile = argv[1];
-    std::string testingFile = argv[2];
-    std::string groundTruthFile = argv[3];
-    std::string resultsFile = argv[4];
-    std::string accuracyFile = argv[5];
+    std::string trainingFile = commandLine.positional[0];
+    std::string testingFile = commandLine.positional[1];
+    std::string groundTruthFile = commandLine.positional[2];
+    std::string resultsFile = commandLine.positional[3];
+    std::string accuracyFile = commandLine.positional[4];
 
     SentimentClassifier classifier;
-    classifier.train(trainingFile);
+    classifier.setPipeline(pipelineFromCommandLine(commandLine));
+    if (!applyIoOption(commandLine, classifier)) {
+        printUsage();
+        return 1;
+    }
+    std::string model = commandLine.get("--model", "counts");
+    if (model == "logistic") {
+        LogisticOptions options;
+        if (!parseLogisticOptions(commandLine, options)) {
+            printUsage();
+            return 1;
+        }
+        classifier.trainLogistic(trainingFile, options, "");
+    }
+    else if (model == "counts") {
+        classifier.train(trainingFile);
+    }
+    else {
+        printUsage();
+        return 1;
+    }
+
+    if (!applyPredictOptions(commandLine, classifier)) {
+        printUsage();
+        return 1;
+    }
+
     classifier.predict(testingFile, resultsFile);
     classifier.evaluatePredictions(groundTruthFile, resultsFile, accuracyFile);
+    classifier.reportQuantization(testingFile, groundTruthFile);
+    classifier.reportTiers(testingFile);
 
     return 0;
 }
+#endif // SENTIMENT_LIBRARY
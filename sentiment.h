@@ -0,0 +1,63 @@
+// Embeddable single-tweet classification API.
+//
+// Build the library by compiling sentiment.cpp without its command-line
+// entry point, e.g.
+//   g++ -std=c++17 -O2 -DSENTIMENT_LIBRARY -c sentiment.cpp -o sentiment.o
+// and link sentiment.o into the host program.
+//
+// A Model is loaded once from a file written by `sentiment train-partial`,
+// `sentiment merge` or `sentiment train-logistic` and is immutable afterwards: classify() does no file I/O
+// and no heap allocation, and any number of threads may call it on the same
+// Model concurrently. Tweets are tokenized with the pipeline options (case,
+// stemming, stop words, bigrams) the model file was trained with.
+#ifndef SENTIMENT_H
+#define SENTIMENT_H
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+namespace sentiment {
+
+struct Classification {
+    int label; // 4 for positive, 0 for negative (same labels as the CSVs)
+    int score; // Sum of the word sentiments (fixed-point logit for logistic models); label is 4 when score >= 0
+};
+
+class FrozenModel; // Defined in sentiment.cpp
+
+class Model {
+public:
+    // Load a model file; throws std::runtime_error if it is missing,
+    // not a model file or truncated. Models only come from load().
+    static Model load(const std::string& modelFile);
+    Model() = delete;
+
+    Classification classify(std::string_view tweet) const;
+    void classify(const std::string_view* tweets, size_t count, Classification* results) const;
+#if __cplusplus >= 202002L
+    // Throws std::invalid_argument unless both spans have the same size
+    void classify(std::span<const std::string_view> tweets, std::span<Classification> results) const {
+        if (tweets.size() != results.size())
+            throw std::invalid_argument("classify: tweets and results differ in size");
+        classify(tweets.data(), tweets.size(), results.data());
+    }
+#endif
+
+    size_t vocabularySize() const;
+
+private:
+    explicit Model(std::shared_ptr<const FrozenModel> model) : frozen(std::move(model)) {}
+
+    std::shared_ptr<const FrozenModel> frozen;
+};
+
+} // namespace sentiment
+
+#endif